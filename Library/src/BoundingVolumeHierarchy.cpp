@@ -0,0 +1,197 @@
+#include "BoundingVolumeHierarchy.h"
+#include <algorithm>
+#include <numeric>
+
+namespace dae
+{
+	namespace
+	{
+		// how much worse a refitted tree may get before Refit asks for a rebuild
+		constexpr float MaxRefitCostGrowth{ 1.5f };
+
+		BoundingBox Merge(const BoundingBox& a, const BoundingBox& b)
+		{
+			BoundingBox result{};
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				result.min[axis] = std::min(a.min[axis], b.min[axis]);
+				result.max[axis] = std::max(a.max[axis], b.max[axis]);
+			}
+			return result;
+		}
+
+		float SurfaceArea(const BoundingBox& box)
+		{
+			const Vector3 size{ box.max - box.min };
+			return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		// Tests the box against the planes still in planeMask. Planes the box lies completely inside of
+		// are taken out of the mask, nothing below this box can be outside of them either.
+		bool IsVisible(const Frustum& frustum, const BoundingBox& box, uint32_t& planeMask)
+		{
+			const Vector3 centre{ (box.min + box.max) * 0.5f };
+			const Vector3 extent{ (box.max - box.min) * 0.5f };
+
+			for (int plane = 0; plane < Frustum::Count; ++plane)
+			{
+				if ((planeMask & (1u << plane)) == 0) continue;
+
+				const Vector4& p = frustum.planes[plane];
+				const float distance = Frustum::Distance(p, centre);
+				const float reach = extent.x * std::abs(p.x) + extent.y * std::abs(p.y) + extent.z * std::abs(p.z);
+
+				if (distance < -reach) return false;
+				if (distance >= reach) planeMask &= ~(1u << plane);
+			}
+			return true;
+		}
+	}
+
+	void BoundingVolumeHierarchy::Build(const std::vector<BoundingBox>& boxes)
+	{
+		m_Boxes = boxes;
+		m_Items.resize(boxes.size());
+		std::iota(m_Items.begin(), m_Items.end(), 0);
+
+		m_Nodes.clear();
+		m_BuildCost = 0.f;
+		if (boxes.empty()) return;
+
+		// a binary tree with at least one item per leaf never needs more nodes than this
+		m_Nodes.reserve(boxes.size() * 2);
+		m_Nodes.push_back({});
+		Subdivide(0, 0, static_cast<uint32_t>(boxes.size()));
+
+		m_BuildCost = ComputeCost();
+	}
+
+	bool BoundingVolumeHierarchy::Refit(const std::vector<BoundingBox>& boxes)
+	{
+		if (boxes.size() != m_Boxes.size()) return false;
+		m_Boxes = boxes;
+
+		// children always come after their parent, so walking backwards updates them first
+		for (size_t nodeIndex = m_Nodes.size(); nodeIndex-- > 0;)
+		{
+			Node& node = m_Nodes[nodeIndex];
+			node.bounds = node.itemCount > 0
+				? MergeItems(node.first, node.itemCount)
+				: Merge(m_Nodes[node.first].bounds, m_Nodes[node.first + 1].bounds);
+		}
+
+		return ComputeCost() <= m_BuildCost * MaxRefitCostGrowth;
+	}
+
+	void BoundingVolumeHierarchy::Query(const Frustum& frustum, const Vector3& origin, std::vector<uint32_t>& result) const
+	{
+		result.clear();
+		if (m_Nodes.empty()) return;
+
+		struct Entry
+		{
+			uint32_t nodeIndex;
+			uint32_t planeMask;
+		};
+
+		// deep enough for any tree Build makes out of 32 bit item counts
+		Entry stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = { 0, (1u << Frustum::Count) - 1 };
+
+		while (stackSize > 0)
+		{
+			const Entry entry = stack[--stackSize];
+			const Node& node = m_Nodes[entry.nodeIndex];
+
+			uint32_t planeMask = entry.planeMask;
+			if (planeMask != 0 && !IsVisible(frustum, node.bounds, planeMask)) continue;
+
+			if (node.itemCount == 0)
+			{
+				stack[stackSize++] = { node.first, planeMask };
+				stack[stackSize++] = { node.first + 1, planeMask };
+				continue;
+			}
+
+			for (uint32_t i = node.first; i < node.first + node.itemCount; ++i)
+			{
+				uint32_t itemMask = planeMask;
+				if (itemMask == 0 || IsVisible(frustum, m_Boxes[m_Items[i]], itemMask))
+				{
+					result.push_back(m_Items[i]);
+				}
+			}
+		}
+
+		std::sort(result.begin(), result.end(), [this, &origin](uint32_t a, uint32_t b)
+			{
+				const Vector3 centreA{ (m_Boxes[a].min + m_Boxes[a].max) * 0.5f };
+				const Vector3 centreB{ (m_Boxes[b].min + m_Boxes[b].max) * 0.5f };
+				return (centreA - origin).SqrMagnitude() < (centreB - origin).SqrMagnitude();
+			});
+	}
+
+	void BoundingVolumeHierarchy::Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t itemCount)
+	{
+		const BoundingBox bounds = MergeItems(first, itemCount);
+		m_Nodes[nodeIndex] = { bounds, first, itemCount };
+		if (itemCount <= MaxLeafSize) return;
+
+		// split along the axis the centres spread furthest on
+		Vector3 centreMin{ (m_Boxes[m_Items[first]].min + m_Boxes[m_Items[first]].max) * 0.5f };
+		Vector3 centreMax{ centreMin };
+		for (uint32_t i = first; i < first + itemCount; ++i)
+		{
+			const Vector3 centre{ (m_Boxes[m_Items[i]].min + m_Boxes[m_Items[i]].max) * 0.5f };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				centreMin[axis] = std::min(centreMin[axis], centre[axis]);
+				centreMax[axis] = std::max(centreMax[axis], centre[axis]);
+			}
+		}
+
+		const Vector3 spread{ centreMax - centreMin };
+		int splitAxis = 0;
+		if (spread.y > spread[splitAxis]) splitAxis = 1;
+		if (spread.z > spread[splitAxis]) splitAxis = 2;
+
+		// every centre in the same spot, splitting would not separate anything
+		if (!(spread[splitAxis] > 0.f)) return;
+
+		const uint32_t middle = first + itemCount / 2;
+		std::nth_element(m_Items.begin() + first, m_Items.begin() + middle, m_Items.begin() + first + itemCount,
+			[this, splitAxis](uint32_t a, uint32_t b)
+			{
+				return m_Boxes[a].min[splitAxis] + m_Boxes[a].max[splitAxis] < m_Boxes[b].min[splitAxis] + m_Boxes[b].max[splitAxis];
+			});
+
+		const uint32_t left = static_cast<uint32_t>(m_Nodes.size());
+		m_Nodes.push_back({});
+		m_Nodes.push_back({});
+		m_Nodes[nodeIndex] = { bounds, left, 0 };
+
+		Subdivide(left, first, middle - first);
+		Subdivide(left + 1, middle, first + itemCount - middle);
+	}
+
+	BoundingBox BoundingVolumeHierarchy::MergeItems(uint32_t first, uint32_t itemCount) const
+	{
+		BoundingBox bounds{ m_Boxes[m_Items[first]] };
+		for (uint32_t i = first + 1; i < first + itemCount; ++i)
+		{
+			bounds = Merge(bounds, m_Boxes[m_Items[i]]);
+		}
+		return bounds;
+	}
+
+	float BoundingVolumeHierarchy::ComputeCost() const
+	{
+		float cost = 0.f;
+		for (const Node& node : m_Nodes)
+		{
+			cost += SurfaceArea(node.bounds);
+		}
+		return cost;
+	}
+}
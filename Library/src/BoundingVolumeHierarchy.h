@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "DataTypes.h"
+#include "Frustum.h"
+
+namespace dae
+{
+	// Binary tree of boxes over a set of items, for culling them against a frustum without testing every one.
+	// Items are the indices of the boxes the tree was built from.
+	class BoundingVolumeHierarchy final
+	{
+	public:
+		static constexpr uint32_t MaxLeafSize{ 4 };
+
+		// top down, every node splits its items at the median centre along the longest axis
+		void Build(const std::vector<BoundingBox>& boxes);
+
+		// Same items with new boxes, the tree keeps its shape and only the node bounds grow or shrink.
+		// Returns false once the nodes overlap so much that a rebuild pays off, the tree is still correct then.
+		bool Refit(const std::vector<BoundingBox>& boxes);
+
+		size_t GetItemCount() const { return m_Boxes.size(); }
+
+		// items whose box touches the frustum, sorted by the distance of their centre to origin, closest first
+		void Query(const Frustum& frustum, const Vector3& origin, std::vector<uint32_t>& result) const;
+
+	private:
+		// inner nodes have no items, their children are the two nodes starting at first
+		struct Node
+		{
+			BoundingBox bounds;
+			uint32_t first;
+			uint32_t itemCount;
+		};
+
+		void Subdivide(uint32_t nodeIndex, uint32_t first, uint32_t itemCount);
+		BoundingBox MergeItems(uint32_t first, uint32_t itemCount) const;
+		float ComputeCost() const;
+
+		std::vector<BoundingBox> m_Boxes;
+		std::vector<uint32_t> m_Items;
+		std::vector<Node> m_Nodes;
+
+		// summed surface area of the nodes right after building, refits compare against it
+		float m_BuildCost{};
+	};
+}
@@ -3,6 +3,7 @@
 #include <SDL_keyboard.h>
 #include <SDL_mouse.h>
 
+#include "Frustum.h"
 #include "Maths.h"
 #include "Timer.h"
 
@@ -31,7 +32,7 @@ namespace dae
 
 
 		float near = 0.1f;
-		float far = 100.f;
+		float far = 1500.f;
 
 		Matrix ProjectionMatrix{};
 		Matrix invViewMatrix{};
@@ -40,6 +41,9 @@ namespace dae
 		Matrix worldMatrix{};
 		float aspectRatioVar{};
 
+		// world space planes of worldViewProectionMatrix
+		Frustum frustum{};
+
 		void Initialize(float aspectRatio, float _fovAngle = 90.f, Vector3 _origin = { 0.f,0.f,0.f })
 		{
 			fovAngle = _fovAngle;
@@ -69,6 +73,7 @@ namespace dae
 
 			ProjectionMatrix = Matrix::CreatePerspectiveFovLH(fov, aspectRatioVar, near, far);
 			worldViewProectionMatrix = invViewMatrix * ProjectionMatrix;
+			frustum = Frustum::FromViewProjection(worldViewProectionMatrix);
 			//DirectX Implementation => https://learn.microsoft.com/en-us/windows/win32/direct3d9/d3dxmatrixperspectivefovlh
 		}
 		Matrix CalculateCameraToWorld()
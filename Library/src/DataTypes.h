@@ -1,6 +1,9 @@
 #pragma once
 #include "Maths.h"
 #include "vector"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 namespace dae
 {
@@ -41,6 +44,50 @@ namespace dae
 		TriangleStrip
 	};
 
+	struct BoundingBox
+	{
+		Vector3 min{};
+		Vector3 max{};
+
+		// box around this box after the transformation, every axis reaches as far as the absolute matrix entries carry the extent
+		BoundingBox Transformed(const Matrix& matrix) const
+		{
+			const Vector3 centre{ matrix.TransformPoint((min + max) * 0.5f) };
+			const Vector3 extent{ (max - min) * 0.5f };
+
+			Vector3 transformedExtent{};
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				transformedExtent[axis] = std::abs(matrix[0][axis]) * extent.x + std::abs(matrix[1][axis]) * extent.y + std::abs(matrix[2][axis]) * extent.z;
+			}
+			return { centre - transformedExtent, centre + transformedExtent };
+		}
+	};
+
+	struct BoundingSphere
+	{
+		Vector3 centre{};
+		float radius{};
+	};
+
+	// A run of triangles of a triangle list mesh, see MeshOptimizer::BuildMeshlets.
+	// Every vertex they use lies in firstVertex up to firstVertex + vertexCount of the mesh's vertex buffer.
+	struct Meshlet
+	{
+		uint32_t firstVertex{};
+		uint32_t vertexCount{};
+		uint32_t firstTriangle{};
+		uint32_t triangleCount{};
+
+		BoundingSphere boundingSphere{};
+
+		// Every triangle normal lies within the cone around coneAxis. The whole meshlet faces away from
+		// a viewer at p when dot(centre - p, coneAxis) >= coneCutoff * |centre - p| + radius.
+		// A cutoff of 1 never passes, the normals spread too far for the test.
+		Vector3 coneAxis{};
+		float coneCutoff{ 1.f };
+	};
+
 	struct Mesh
 	{
 		std::vector<Vertex> vertices{};
@@ -49,6 +96,47 @@ namespace dae
 		
 		Matrix worldMatrix{};
 
+		// model space bounds, have to be recomputed whenever the vertices change
+		BoundingBox boundingBox{};
+		BoundingSphere boundingSphere{};
+
+		// empty when the mesh is drawn as a whole
+		std::vector<Meshlet> meshlets{};
+
+		// coarser versions of this mesh, see MeshSimplifier::BuildLods
+		std::vector<Mesh> lods{};
+		// how far this mesh may be off the one it was simplified from, 0 for the original
+		float lodError{};
+
+		void ComputeBounds()
+		{
+			if (vertices.empty())
+			{
+				boundingBox = {};
+				boundingSphere = {};
+				return;
+			}
+
+			boundingBox = { vertices[0].position, vertices[0].position };
+			for (const Vertex& vertex : vertices)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					boundingBox.min[axis] = std::min(boundingBox.min[axis], vertex.position[axis]);
+					boundingBox.max[axis] = std::max(boundingBox.max[axis], vertex.position[axis]);
+				}
+			}
+
+			// centred on the box, not the tightest sphere but never further off than the box corners
+			boundingSphere.centre = (boundingBox.min + boundingBox.max) * 0.5f;
+			boundingSphere.radius = 0.f;
+			for (const Vertex& vertex : vertices)
+			{
+				boundingSphere.radius = std::max(boundingSphere.radius, (vertex.position - boundingSphere.centre).SqrMagnitude());
+			}
+			boundingSphere.radius = std::sqrt(boundingSphere.radius);
+		}
+
 		void RotateY(float yaw)
 		{
 			worldMatrix = Matrix::CreateRotationY(yaw);
@@ -63,10 +151,34 @@ namespace dae
 		}
 	};
 
+	class Texture;
+
+	// Maps a mesh is shaded with, all four have to be set and outlive every draw that uses them
+	struct Material
+	{
+		const Texture* pDiffuse{};
+		const Texture* pNormal{};
+		const Texture* pSpecular{};
+		const Texture* pGlossiness{};
+	};
+
+	// One entry of the draw list, the mesh and material are referenced instead of copied.
+	// Instances of a mesh are entries that share pMesh, only the matrix and tint are stored per instance.
+	struct DrawCommand
+	{
+		const Mesh* pMesh{};
+		Matrix worldMatrix{};
+		const Material* pMaterial{};
+		// multiplies the shaded colour
+		ColorRGB tint{ colors::White };
+	};
+
+	// Transformed copy of a mesh. The vertices are kept between frames and only resized when the mesh changes,
+	// the indices never change during transformation so they point at the source mesh.
 	struct Mesh4AxisVertex
 	{
 		std::vector<Vertex_Out> vertices_out{};
-		std::vector<uint32_t> indices{};
+		const std::vector<uint32_t>* pIndices{};
 		PrimitiveTopology primitiveTopology{ PrimitiveTopology::TriangleStrip };
 
 		Matrix worldMatrix{};
@@ -0,0 +1,83 @@
+#pragma once
+#include <cmath>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// The six planes of the view frustum in world space, as (a, b, c, d) with a*x + b*y + c*z + d >= 0 inside.
+	// Extracted from a view projection matrix, so they always match what the projection keeps on screen.
+	struct Frustum
+	{
+		enum Plane
+		{
+			Left,
+			Right,
+			Bottom,
+			Top,
+			Near,
+			Far,
+			Count
+		};
+
+		Vector4 planes[Count]{};
+
+		// Positions are row vectors, clip = p * M, so every clip component is p dotted with a column of M.
+		// The clip volume is -w <= x <= w, -w <= y <= w and 0 <= z <= w, every bound gives one plane.
+		static Frustum FromViewProjection(const Matrix& m)
+		{
+			const auto column = [&m](int index)
+			{
+				return Vector4{ m[0][index], m[1][index], m[2][index], m[3][index] };
+			};
+
+			const Vector4 x{ column(0) };
+			const Vector4 y{ column(1) };
+			const Vector4 z{ column(2) };
+			const Vector4 w{ column(3) };
+
+			Frustum frustum{};
+			frustum.planes[Left] = w + x;
+			frustum.planes[Right] = w - x;
+			frustum.planes[Bottom] = w + y;
+			frustum.planes[Top] = w - y;
+			frustum.planes[Near] = z;
+			frustum.planes[Far] = w - z;
+
+			// normalized so the plane distance is a real distance, the sphere test needs that
+			for (Vector4& plane : frustum.planes)
+			{
+				const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+				plane = plane * (1.f / length);
+			}
+			return frustum;
+		}
+
+		static float Distance(const Vector4& plane, const Vector3& point)
+		{
+			return plane.x * point.x + plane.y * point.y + plane.z * point.z + plane.w;
+		}
+
+		// conservative, a sphere outside of the corner of two planes still counts as visible
+		bool Intersects(const BoundingSphere& sphere) const
+		{
+			for (const Vector4& plane : planes)
+			{
+				if (Distance(plane, sphere.centre) < -sphere.radius) return false;
+			}
+			return true;
+		}
+
+		bool Intersects(const BoundingBox& box) const
+		{
+			const Vector3 centre{ (box.min + box.max) * 0.5f };
+			const Vector3 extent{ (box.max - box.min) * 0.5f };
+			for (const Vector4& plane : planes)
+			{
+				// how far the box reaches towards the plane normal
+				const float reach = extent.x * std::abs(plane.x) + extent.y * std::abs(plane.y) + extent.z * std::abs(plane.z);
+				if (Distance(plane, centre) < -reach) return false;
+			}
+			return true;
+		}
+	};
+}
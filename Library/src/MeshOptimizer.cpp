@@ -0,0 +1,562 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace dae
+{
+	namespace MeshOptimizer
+	{
+		namespace
+		{
+			// scoring constants from Forsyth's article
+			constexpr float LastTriangleScore{ 0.75f };
+			constexpr float CacheDecayPower{ 1.5f };
+			constexpr float ValenceBoostScale{ 2.f };
+			constexpr float ValenceBoostPower{ 0.5f };
+
+			float ScoreVertex(int cachePosition, uint32_t liveTriangles)
+			{
+				// nothing left to draw with it, keep it out of every decision
+				if (liveTriangles == 0) return -1.f;
+
+				float score{};
+				if (cachePosition >= 0)
+				{
+					// the three most recent ones were used by the last triangle, so they get a fixed score
+					if (cachePosition < 3)
+					{
+						score = LastTriangleScore;
+					}
+					else
+					{
+						const float scaler = 1.f / (CacheSize - 3);
+						score = std::pow(1.f - (cachePosition - 3) * scaler, CacheDecayPower);
+					}
+				}
+
+				// vertices with few triangles left are finished off first so they can leave the cache
+				score += ValenceBoostScale * std::pow(static_cast<float>(liveTriangles), -ValenceBoostPower);
+				return score;
+			}
+
+			// fifo cache as the hardware would run it, a vertex is cached while fewer than CacheSize misses happened since it got loaded
+			class CacheSimulation
+			{
+			public:
+				explicit CacheSimulation(size_t vertexCount) : m_LoadTime(vertexCount, 0) {}
+
+				// true on a miss
+				bool Access(uint32_t vertex)
+				{
+					if (m_LoadTime[vertex] != 0 && m_Time - m_LoadTime[vertex] < CacheSize) return false;
+
+					m_LoadTime[vertex] = ++m_Time;
+					return true;
+				}
+
+			private:
+				std::vector<uint32_t> m_LoadTime;
+				uint32_t m_Time{};
+			};
+
+			// front faces wind clockwise on screen, for those the cross product of the edges points towards the viewer
+			bool ComputeTriangleNormal(const std::vector<Vertex>& vertices, const uint32_t* pTriangle, Vector3& normal)
+			{
+				const Vector3& p0 = vertices[pTriangle[0]].position;
+				normal = Vector3::Cross(vertices[pTriangle[1]].position - p0, vertices[pTriangle[2]].position - p0);
+
+				const float length = normal.Magnitude();
+				if (!(length > 0.f)) return false;
+
+				normal /= length;
+				return true;
+			}
+
+			void ComputeMeshletBounds(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, Meshlet& meshlet)
+			{
+				// the vertex range can hold vertices of other meshlets too, so the bounds go over the corners
+				// of its own triangles, visiting shared ones more than once changes nothing
+				const uint32_t* pTriangles = indices.data() + meshlet.firstTriangle * 3;
+				const uint32_t cornerCount = meshlet.triangleCount * 3;
+
+				// sphere around the box centre, same as Mesh::ComputeBounds
+				Vector3 min{ vertices[pTriangles[0]].position };
+				Vector3 max{ min };
+				for (uint32_t corner = 0; corner < cornerCount; ++corner)
+				{
+					const Vector3& position = vertices[pTriangles[corner]].position;
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						min[axis] = std::min(min[axis], position[axis]);
+						max[axis] = std::max(max[axis], position[axis]);
+					}
+				}
+
+				BoundingSphere& sphere = meshlet.boundingSphere;
+				sphere.centre = (min + max) * 0.5f;
+				sphere.radius = 0.f;
+				for (uint32_t corner = 0; corner < cornerCount; ++corner)
+				{
+					sphere.radius = std::max(sphere.radius, (vertices[pTriangles[corner]].position - sphere.centre).SqrMagnitude());
+				}
+				sphere.radius = std::sqrt(sphere.radius);
+
+				// the cone points along the average triangle normal and opens as far as the furthest one
+
+				Vector3 axis{};
+				Vector3 normal{};
+				for (uint32_t triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+				{
+					if (ComputeTriangleNormal(vertices, pTriangles + triangle * 3, normal)) axis += normal;
+				}
+
+				meshlet.coneCutoff = 1.f;
+				const float axisLength = axis.Magnitude();
+				if (!(axisLength > 0.f)) return;
+
+				meshlet.coneAxis = axis / axisLength;
+
+				float minDot = 1.f;
+				for (uint32_t triangle = 0; triangle < meshlet.triangleCount; ++triangle)
+				{
+					if (ComputeTriangleNormal(vertices, pTriangles + triangle * 3, normal))
+					{
+						minDot = std::min(minDot, Vector3::Dot(meshlet.coneAxis, normal));
+					}
+				}
+
+				// past 90 degrees some triangle faces every viewer, so the cone is no use
+				if (minDot <= 0.f) return;
+
+				meshlet.coneCutoff = std::sqrt(1.f - minDot * minDot);
+			}
+		}
+
+		float ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			if (indices.size() < 3) return 0.f;
+
+			CacheSimulation cache{ vertexCount };
+
+			size_t misses{};
+			for (const uint32_t index : indices)
+			{
+				if (cache.Access(index)) ++misses;
+			}
+
+			return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+		}
+
+		float ComputeOverdraw(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			constexpr int gridSize = 256;
+
+			if (vertices.empty() || indices.size() < 3) return 0.f;
+
+			Vector3 minimum = vertices[0].position;
+			Vector3 maximum = vertices[0].position;
+			for (const Vertex& vertex : vertices)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+					maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+				}
+			}
+
+			const Vector3 extent = maximum - minimum;
+			const float scale = (gridSize - 1) / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
+
+			std::vector<float> depthBuffer(gridSize * gridSize);
+			size_t shaded{};
+			size_t covered{};
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				const int axisU = (axis + 1) % 3;
+				const int axisV = (axis + 2) % 3;
+
+				// the viewer looks along the axis, towards increasing depth
+				for (const float direction : { 1.f, -1.f })
+				{
+					std::fill(depthBuffer.begin(), depthBuffer.end(), std::numeric_limits<float>::max());
+
+					for (size_t i = 0; i + 2 < indices.size(); i += 3)
+					{
+						// back faces are culled by their vertex normals, that works whatever winding the mesh uses
+						float facing{};
+						float u[3];
+						float v[3];
+						float depth[3];
+						for (int corner = 0; corner < 3; ++corner)
+						{
+							const Vertex& vertex = vertices[indices[i + corner]];
+							const Vector3 position = vertex.position - minimum;
+							u[corner] = position[axisU] * scale;
+							v[corner] = position[axisV] * scale;
+							depth[corner] = position[axis] * direction;
+							facing += vertex.normal[axis] * direction;
+						}
+
+						if (facing >= 0) continue;
+
+						float area = (u[1] - u[0]) * (v[2] - v[0]) - (u[2] - u[0]) * (v[1] - v[0]);
+						if (area == 0) continue;
+						if (area < 0)
+						{
+							std::swap(u[1], u[2]);
+							std::swap(v[1], v[2]);
+							std::swap(depth[1], depth[2]);
+							area = -area;
+						}
+
+						const int minX = std::max(static_cast<int>(std::floor(std::min({ u[0], u[1], u[2] }))), 0);
+						const int maxX = std::min(static_cast<int>(std::ceil(std::max({ u[0], u[1], u[2] }))), gridSize - 1);
+						const int minY = std::max(static_cast<int>(std::floor(std::min({ v[0], v[1], v[2] }))), 0);
+						const int maxY = std::min(static_cast<int>(std::ceil(std::max({ v[0], v[1], v[2] }))), gridSize - 1);
+
+						for (int y = minY; y <= maxY; ++y)
+						{
+							for (int x = minX; x <= maxX; ++x)
+							{
+								const float px = static_cast<float>(x) + 0.5f;
+								const float py = static_cast<float>(y) + 0.5f;
+
+								// barycentric weights, all positive inside
+								const float w0 = (u[2] - u[1]) * (py - v[1]) - (v[2] - v[1]) * (px - u[1]);
+								const float w1 = (u[0] - u[2]) * (py - v[2]) - (v[0] - v[2]) * (px - u[2]);
+								const float w2 = (u[1] - u[0]) * (py - v[0]) - (v[1] - v[0]) * (px - u[0]);
+								if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+
+								const float pixelDepth = (w0 * depth[0] + w1 * depth[1] + w2 * depth[2]) / area;
+								float& bufferDepth = depthBuffer[x + y * gridSize];
+								if (pixelDepth < bufferDepth)
+								{
+									if (bufferDepth == std::numeric_limits<float>::max()) ++covered;
+
+									bufferDepth = pixelDepth;
+									++shaded;
+								}
+							}
+						}
+					}
+				}
+			}
+
+			return covered == 0 ? 0.f : static_cast<float>(shaded) / static_cast<float>(covered);
+		}
+
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount)
+		{
+			const size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0) return;
+
+			// triangles using every vertex, liveTriangles shrinks while they get emitted
+			std::vector<uint32_t> liveTriangles(vertexCount, 0);
+			for (size_t i = 0; i < triangleCount * 3; ++i)
+			{
+				++liveTriangles[indices[i]];
+			}
+
+			std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+			std::partial_sum(liveTriangles.begin(), liveTriangles.end(), adjacencyOffsets.begin() + 1);
+
+			std::vector<uint32_t> adjacency(triangleCount * 3);
+			{
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (size_t i = 0; i < triangleCount * 3; ++i)
+				{
+					adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+				}
+			}
+
+			std::vector<float> vertexScores(vertexCount);
+			for (size_t vertex = 0; vertex < vertexCount; ++vertex)
+			{
+				vertexScores[vertex] = ScoreVertex(-1, liveTriangles[vertex]);
+			}
+
+			std::vector<float> triangleScores(triangleCount);
+			std::vector<uint8_t> emitted(triangleCount, false);
+			for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+			{
+				triangleScores[triangle] = vertexScores[indices[triangle * 3]] + vertexScores[indices[triangle * 3 + 1]] + vertexScores[indices[triangle * 3 + 2]];
+			}
+
+			// room for a full cache plus the three vertices pushed in front of it
+			std::vector<uint32_t> cache;
+			std::vector<uint32_t> nextCache;
+			cache.reserve(CacheSize + 3);
+			nextCache.reserve(CacheSize + 3);
+
+			std::vector<uint32_t> result;
+			result.reserve(triangleCount * 3);
+
+			int64_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+			size_t scanCursor = 0;
+
+			while (result.size() < triangleCount * 3)
+			{
+				// nothing in the cache has triangles left, continue with the next one that was never emitted
+				if (bestTriangle < 0)
+				{
+					while (emitted[scanCursor]) ++scanCursor;
+					bestTriangle = static_cast<int64_t>(scanCursor);
+				}
+
+				const uint32_t* corners = &indices[bestTriangle * 3];
+				emitted[bestTriangle] = true;
+
+				nextCache.clear();
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					const uint32_t vertex = corners[corner];
+					result.push_back(vertex);
+					nextCache.push_back(vertex);
+
+					// take the triangle out of the vertex' list so only live ones are scored from now on
+					uint32_t* first = &adjacency[adjacencyOffsets[vertex]];
+					uint32_t* last = first + liveTriangles[vertex];
+					std::iter_swap(std::find(first, last, static_cast<uint32_t>(bestTriangle)), last - 1);
+					--liveTriangles[vertex];
+				}
+
+				for (const uint32_t vertex : cache)
+				{
+					if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2]) nextCache.push_back(vertex);
+				}
+
+				// whatever falls off the end is no longer cached
+				if (nextCache.size() > CacheSize)
+				{
+					for (size_t position = CacheSize; position < nextCache.size(); ++position)
+					{
+						const uint32_t vertex = nextCache[position];
+						const float score = ScoreVertex(-1, liveTriangles[vertex]);
+						const float delta = score - vertexScores[vertex];
+						vertexScores[vertex] = score;
+
+						for (uint32_t i = 0; i < liveTriangles[vertex]; ++i)
+						{
+							triangleScores[adjacency[adjacencyOffsets[vertex] + i]] += delta;
+						}
+					}
+					nextCache.resize(CacheSize);
+				}
+
+				std::swap(cache, nextCache);
+
+				// rescore everything in the cache and pick the best triangle touching it
+				bestTriangle = -1;
+				float bestScore = -std::numeric_limits<float>::max();
+
+				for (size_t position = 0; position < cache.size(); ++position)
+				{
+					const uint32_t vertex = cache[position];
+					const float score = ScoreVertex(static_cast<int>(position), liveTriangles[vertex]);
+					const float delta = score - vertexScores[vertex];
+					vertexScores[vertex] = score;
+
+					for (uint32_t i = 0; i < liveTriangles[vertex]; ++i)
+					{
+						triangleScores[adjacency[adjacencyOffsets[vertex] + i]] += delta;
+					}
+				}
+
+				for (const uint32_t vertex : cache)
+				{
+					for (uint32_t i = 0; i < liveTriangles[vertex]; ++i)
+					{
+						const uint32_t triangle = adjacency[adjacencyOffsets[vertex] + i];
+						if (triangleScores[triangle] > bestScore)
+						{
+							bestScore = triangleScores[triangle];
+							bestTriangle = triangle;
+						}
+					}
+				}
+			}
+
+			// a trailing partial triangle is kept as it was
+			std::copy(result.begin(), result.end(), indices.begin());
+		}
+
+		void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			const size_t triangleCount = indices.size() / 3;
+			if (triangleCount == 0) return;
+
+			struct Cluster
+			{
+				size_t firstTriangle;
+				size_t lastTriangle;
+				float sortKey;
+			};
+
+			// a triangle missing the cache with all three vertices starts over anyway, so splitting there costs nothing
+			std::vector<Cluster> clusters;
+			CacheSimulation cache{ vertices.size() };
+			for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+			{
+				int misses{};
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					if (cache.Access(indices[triangle * 3 + corner])) ++misses;
+				}
+
+				if (triangle == 0 || misses == 3 || (misses >= 2 && triangle - clusters.back().firstTriangle >= 64))
+				{
+					clusters.push_back({ triangle, triangle + 1, 0.f });
+				}
+				else
+				{
+					clusters.back().lastTriangle = triangle + 1;
+				}
+			}
+
+			Vector3 meshCentre{};
+			for (const Vertex& vertex : vertices)
+			{
+				meshCentre += vertex.position;
+			}
+			meshCentre /= static_cast<float>(std::max<size_t>(vertices.size(), 1));
+
+			// clusters further out along their own normal are more likely to cover something
+			for (Cluster& cluster : clusters)
+			{
+				Vector3 centre{};
+				Vector3 normal{};
+				for (size_t i = cluster.firstTriangle * 3; i < cluster.lastTriangle * 3; ++i)
+				{
+					centre += vertices[indices[i]].position;
+					normal += vertices[indices[i]].normal;
+				}
+
+				centre /= static_cast<float>((cluster.lastTriangle - cluster.firstTriangle) * 3);
+				const float length = normal.Magnitude();
+				cluster.sortKey = length > 0 ? Vector3::Dot(centre - meshCentre, normal / length) : 0.f;
+			}
+
+			std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b)
+				{
+					return a.sortKey > b.sortKey;
+				});
+
+			std::vector<uint32_t> sorted;
+			sorted.reserve(indices.size());
+			for (const Cluster& cluster : clusters)
+			{
+				sorted.insert(sorted.end(), indices.begin() + cluster.firstTriangle * 3, indices.begin() + cluster.lastTriangle * 3);
+			}
+
+			std::copy(sorted.begin(), sorted.end(), indices.begin());
+		}
+
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+
+			std::vector<uint32_t> remap(vertices.size(), unused);
+			std::vector<Vertex> reordered;
+			reordered.reserve(vertices.size());
+
+			for (uint32_t& index : indices)
+			{
+				if (remap[index] == unused)
+				{
+					remap[index] = static_cast<uint32_t>(reordered.size());
+					reordered.push_back(vertices[index]);
+				}
+
+				index = remap[index];
+			}
+
+			// vertices no triangle uses are dropped
+			vertices = std::move(reordered);
+		}
+
+		Report Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool reduceOverdraw)
+		{
+			Report report{};
+			report.before = { ComputeACMR(indices, vertices.size()), ComputeOverdraw(vertices, indices) };
+
+			OptimizeVertexCache(indices, vertices.size());
+			if (reduceOverdraw)
+			{
+				OptimizeOverdraw(vertices, indices);
+			}
+			OptimizeVertexFetch(vertices, indices);
+
+			report.after = { ComputeACMR(indices, vertices.size()), ComputeOverdraw(vertices, indices) };
+			return report;
+		}
+
+		std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+		{
+			std::vector<Meshlet> meshlets;
+			if (indices.size() / 3 < static_cast<size_t>(MinMeshletTriangles)) return meshlets;
+
+			// whether a vertex is already used by the meshlet being built, reset for the ones in used when it is done
+			std::vector<bool> inMeshlet(vertices.size(), false);
+			std::vector<uint32_t> used;
+
+			Meshlet meshlet{};
+			uint32_t minVertex = std::numeric_limits<uint32_t>::max();
+			uint32_t maxVertex = 0;
+			const auto finishMeshlet = [&]()
+			{
+				if (meshlet.triangleCount == 0) return;
+
+				for (const uint32_t vertex : used)
+				{
+					inMeshlet[vertex] = false;
+				}
+				used.clear();
+
+				meshlet.firstVertex = minVertex;
+				meshlet.vertexCount = maxVertex - minVertex + 1;
+				ComputeMeshletBounds(vertices, indices, meshlet);
+				meshlets.push_back(meshlet);
+
+				meshlet = {};
+				meshlet.firstTriangle = meshlets.back().firstTriangle + meshlets.back().triangleCount;
+				minVertex = std::numeric_limits<uint32_t>::max();
+				maxVertex = 0;
+			};
+
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				uint32_t newVertexCount = 0;
+				for (size_t corner = i; corner < i + 3; ++corner)
+				{
+					if (!inMeshlet[indices[corner]]) ++newVertexCount;
+				}
+
+				// the vertex limit keeps the bounds tight
+				if (static_cast<uint32_t>(used.size()) + newVertexCount > static_cast<uint32_t>(MaxMeshletVertices) || meshlet.triangleCount == static_cast<uint32_t>(MaxMeshletTriangles))
+				{
+					finishMeshlet();
+				}
+
+				for (size_t corner = i; corner < i + 3; ++corner)
+				{
+					const uint32_t index = indices[corner];
+					if (!inMeshlet[index])
+					{
+						inMeshlet[index] = true;
+						used.push_back(index);
+						minVertex = std::min(minVertex, index);
+						maxVertex = std::max(maxVertex, index);
+					}
+				}
+
+				++meshlet.triangleCount;
+			}
+			finishMeshlet();
+
+			return meshlets;
+		}
+	}
+}
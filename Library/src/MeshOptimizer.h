@@ -0,0 +1,62 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Load time reordering of indexed triangle lists, meant to run on what Utils::ParseOBJ returns.
+	// Only the order of triangles and vertices changes, the mesh looks exactly the same.
+	namespace MeshOptimizer
+	{
+		// size of the simulated post transform cache
+		constexpr int CacheSize{ 32 };
+
+		struct Statistics
+		{
+			// transformed vertices per triangle, 3 without any reuse and about 0.5 at best
+			float acmr{};
+			// pixels shaded per pixel covered, averaged over views along the six axes
+			float overdraw{};
+		};
+
+		struct Report
+		{
+			Statistics before{};
+			Statistics after{};
+		};
+
+		// vertex cache misses per triangle in a FIFO cache of CacheSize entries
+		float ComputeACMR(const std::vector<uint32_t>& indices, size_t vertexCount);
+
+		// rasterizes the mesh from the six axis directions on a small grid and counts how often pixels get shaded
+		float ComputeOverdraw(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		// Forsyth's linear speed vertex cache optimisation, greedily emits the triangle whose vertices
+		// score highest on cache position and on how few triangles still need them
+		void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+		// Splits the cache ordered triangles wherever the cache starts cold and sorts those clusters
+		// so the ones facing away from the mesh centre come first, they tend to hide the rest.
+		// Keeps most of the cache locality since clusters stay intact.
+		void OptimizeOverdraw(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// renumbers vertices in the order the indices first use them, so fetching walks memory forward
+		void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+		// runs all of the above on a triangle list and measures before and after
+		Report Optimize(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, bool reduceOverdraw = true);
+
+		// limits per meshlet, the vertex count is the one that usually runs out first
+		constexpr int MaxMeshletVertices{ 64 };
+		constexpr int MaxMeshletTriangles{ 124 };
+		// below this a mesh gets no meshlets, culling a handful of them saves less than walking them costs
+		constexpr int MinMeshletTriangles{ 4 * MaxMeshletTriangles };
+
+		// Cuts the triangle list into meshlets in the order the triangles come, so it should run after Optimize.
+		// Nothing is moved or duplicated, a meshlet is a run of triangles plus the range of the shared vertex buffer
+		// they use. OptimizeVertexFetch numbers vertices in the order triangles first use them, which keeps those ranges short.
+		// Neighbouring ranges overlap where meshlets share vertices.
+		std::vector<Meshlet> BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+	}
+}
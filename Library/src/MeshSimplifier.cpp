@@ -0,0 +1,388 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include "Utils.h"
+
+namespace dae
+{
+	namespace MeshSimplifier
+	{
+		namespace
+		{
+			// Sum of squared distances to a set of planes, every plane weighted by the area of its triangle.
+			// Only the upper half of the symmetric 4x4 matrix is kept.
+			struct Quadric
+			{
+				float a00, a01, a02, a11, a12, a22;
+				float b0, b1, b2;
+				float c;
+				float weight;
+
+				static Quadric FromPlane(const Vector3& normal, float distance, float weight)
+				{
+					const float a = normal.x * weight;
+					const float b = normal.y * weight;
+					const float d = normal.z * weight;
+					return
+					{
+						a * normal.x, a * normal.y, a * normal.z, b * normal.y, b * normal.z, d * normal.z,
+						a * distance, b * distance, d * distance,
+						distance * distance * weight,
+						weight
+					};
+				}
+
+				Quadric& operator+=(const Quadric& q)
+				{
+					a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+					b0 += q.b0; b1 += q.b1; b2 += q.b2;
+					c += q.c;
+					weight += q.weight;
+					return *this;
+				}
+
+				// mean squared distance of p to the planes
+				float Evaluate(const Vector3& p) const
+				{
+					const float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+					const float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+					const float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+					const float error = p.x * rx + p.y * ry + p.z * rz + 2.f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+					return weight > 0.f ? std::abs(error) / weight : 0.f;
+				}
+			};
+
+			struct PositionHash
+			{
+				size_t operator()(const Vector3& position) const
+				{
+					const float components[3]{ position.x, position.y, position.z };
+					return Utils::HashFloats(components, 3);
+				}
+			};
+
+			struct PositionEqual
+			{
+				bool operator()(const Vector3& a, const Vector3& b) const
+				{
+					return a.x == b.x && a.y == b.y && a.z == b.z;
+				}
+			};
+
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+				float error;
+			};
+
+			Vector3 ComputeNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+			{
+				return Vector3::Cross(p1 - p0, p2 - p0);
+			}
+
+			uint64_t EdgeKey(uint32_t from, uint32_t to)
+			{
+				return (static_cast<uint64_t>(from) << 32) | to;
+			}
+
+			// the other positions of the triangles around position, sorted and each only once
+			void GatherNeighbours(uint32_t position, const std::vector<uint32_t>& firstTriangles, const std::vector<uint32_t>& vertexTriangles,
+				const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, std::vector<uint32_t>& neighbours)
+			{
+				neighbours.clear();
+				for (uint32_t t = firstTriangles[position]; t < firstTriangles[position + 1]; ++t)
+				{
+					const uint32_t* pTriangle = indices.data() + vertexTriangles[t] * 3;
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						const uint32_t neighbour = positionIds[pTriangle[corner]];
+						if (neighbour != position) neighbours.push_back(neighbour);
+					}
+				}
+				std::sort(neighbours.begin(), neighbours.end());
+				neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+			}
+		}
+
+		float Simplify(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, size_t targetIndexCount, float targetError)
+		{
+			const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+			// vertices split on a uv or normal seam share a position, they all point at the first one
+			std::vector<uint32_t> positionIds(vertexCount);
+			std::vector<uint32_t> positionUses(vertexCount, 0);
+			{
+				std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> firstVertices{};
+				for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+				{
+					positionIds[vertex] = firstVertices.emplace(vertices[vertex].position, vertex).first->second;
+					++positionUses[positionIds[vertex]];
+				}
+			}
+
+			// seam vertices and the ends of edges only one triangle uses stay where they are
+			std::vector<bool> locked(vertexCount, false);
+			{
+				std::unordered_set<uint64_t> edges{};
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						edges.insert(EdgeKey(positionIds[indices[i + corner]], positionIds[indices[i + (corner + 1) % 3]]));
+					}
+				}
+
+				for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+				{
+					locked[vertex] = positionUses[positionIds[vertex]] > 1;
+				}
+
+				for (size_t i = 0; i + 2 < indices.size(); i += 3)
+				{
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						const uint32_t a = indices[i + corner];
+						const uint32_t b = indices[i + (corner + 1) % 3];
+						if (edges.count(EdgeKey(positionIds[b], positionIds[a])) == 0)
+						{
+							locked[a] = true;
+							locked[b] = true;
+						}
+					}
+				}
+			}
+
+			std::vector<Quadric> quadrics(vertexCount, Quadric{});
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				const Vector3& p0 = vertices[indices[i]].position;
+				Vector3 normal = ComputeNormal(p0, vertices[indices[i + 1]].position, vertices[indices[i + 2]].position);
+
+				const float doubleArea = normal.Magnitude();
+				if (!(doubleArea > 0.f)) continue;
+
+				normal /= doubleArea;
+				const Quadric quadric = Quadric::FromPlane(normal, -Vector3::Dot(normal, p0), doubleArea * 0.5f);
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					quadrics[positionIds[indices[i + corner]]] += quadric;
+				}
+			}
+
+			const float maxError = targetError * targetError;
+			float resultError = 0.f;
+
+			std::vector<uint32_t> remap(vertexCount);
+			std::vector<bool> touched(vertexCount);
+			std::vector<uint32_t> firstTriangles(vertexCount + 1);
+			std::vector<uint32_t> vertexTriangles;
+			std::vector<Collapse> collapses;
+			std::vector<uint32_t> fromNeighbours;
+			std::vector<uint32_t> toNeighbours;
+			std::vector<uint32_t> edgeCorners;
+
+			// every pass collapses the cheapest edges that do not share a triangle, then cleans up
+			while (indices.size() > targetIndexCount)
+			{
+				const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+
+				// triangles around every position, counted and then filled in, seam vertices share the list of their position
+				std::fill(firstTriangles.begin(), firstTriangles.end(), 0);
+				for (const uint32_t index : indices)
+				{
+					++firstTriangles[positionIds[index] + 1];
+				}
+				for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+				{
+					firstTriangles[vertex + 1] += firstTriangles[vertex];
+				}
+				vertexTriangles.resize(indices.size());
+				{
+					std::vector<uint32_t> fill(firstTriangles.begin(), firstTriangles.end() - 1);
+					for (uint32_t i = 0; i < indices.size(); ++i)
+					{
+						vertexTriangles[fill[positionIds[indices[i]]]++] = i / 3;
+					}
+				}
+
+				collapses.clear();
+				for (uint32_t i = 0; i < indices.size(); i += 3)
+				{
+					for (int corner = 0; corner < 3; ++corner)
+					{
+						const uint32_t a = indices[i + corner];
+						const uint32_t b = indices[i + (corner + 1) % 3];
+						const Vector3& positionA = vertices[a].position;
+						const Vector3& positionB = vertices[b].position;
+
+						Quadric quadric = quadrics[positionIds[a]];
+						quadric += quadrics[positionIds[b]];
+
+						if (!locked[a]) collapses.push_back({ a, b, quadric.Evaluate(positionB) });
+						if (!locked[b]) collapses.push_back({ b, a, quadric.Evaluate(positionA) });
+					}
+				}
+
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+					{
+						return a.error < b.error;
+					});
+
+				for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+				{
+					remap[vertex] = vertex;
+				}
+				std::fill(touched.begin(), touched.end(), false);
+
+				// a collapse takes about two triangles, so this pass stops close to the target
+				const size_t collapseLimit = std::max<size_t>((indices.size() - targetIndexCount) / 6, 1);
+				size_t collapseCount = 0;
+
+				for (const Collapse& collapse : collapses)
+				{
+					if (collapse.error > maxError || collapseCount >= collapseLimit) break;
+					if (touched[collapse.from] || touched[collapse.to]) continue;
+
+					// Rejects collapses that turn a remaining triangle over, and those onto a seam position
+					// where some triangle around the removed vertex uses another vertex of the seam.
+					const Vector3& target = vertices[collapse.to].position;
+					const uint32_t targetPosition = positionIds[collapse.to];
+					bool flips = false;
+					for (uint32_t t = firstTriangles[collapse.from]; t < firstTriangles[collapse.from + 1] && !flips; ++t)
+					{
+						const uint32_t* pTriangle = indices.data() + vertexTriangles[t] * 3;
+
+						bool hasTarget = false;
+						for (int corner = 0; corner < 3; ++corner)
+						{
+							hasTarget |= pTriangle[corner] == collapse.to;
+							flips |= pTriangle[corner] != collapse.to && positionIds[pTriangle[corner]] == targetPosition;
+						}
+						if (hasTarget || flips) continue;
+
+						Vector3 corners[3]{ vertices[pTriangle[0]].position, vertices[pTriangle[1]].position, vertices[pTriangle[2]].position };
+						const Vector3 before = ComputeNormal(corners[0], corners[1], corners[2]);
+						for (int corner = 0; corner < 3; ++corner)
+						{
+							if (pTriangle[corner] == collapse.from) corners[corner] = target;
+						}
+						const Vector3 after = ComputeNormal(corners[0], corners[1], corners[2]);
+
+						flips = Vector3::Dot(before, after) <= 0.f;
+					}
+					if (flips) continue;
+
+					// Rejects collapses that pinch the surface: a position next to both ends that is not the third corner
+					// of a triangle on the edge would be left with two triangles on one edge, or the same triangle twice.
+					const uint32_t fromPosition = positionIds[collapse.from];
+					GatherNeighbours(fromPosition, firstTriangles, vertexTriangles, indices, positionIds, fromNeighbours);
+					GatherNeighbours(targetPosition, firstTriangles, vertexTriangles, indices, positionIds, toNeighbours);
+
+					edgeCorners.clear();
+					for (uint32_t t = firstTriangles[fromPosition]; t < firstTriangles[fromPosition + 1]; ++t)
+					{
+						const uint32_t* pTriangle = indices.data() + vertexTriangles[t] * 3;
+						uint32_t third = fromPosition;
+						bool onEdge = false;
+						for (int corner = 0; corner < 3; ++corner)
+						{
+							const uint32_t position = positionIds[pTriangle[corner]];
+							onEdge |= position == targetPosition;
+							if (position != fromPosition && position != targetPosition) third = position;
+						}
+						if (onEdge) edgeCorners.push_back(third);
+					}
+					std::sort(edgeCorners.begin(), edgeCorners.end());
+					edgeCorners.erase(std::unique(edgeCorners.begin(), edgeCorners.end()), edgeCorners.end());
+
+					size_t sharedNeighbours = 0;
+					for (auto from = fromNeighbours.begin(), to = toNeighbours.begin(); from != fromNeighbours.end() && to != toNeighbours.end();)
+					{
+						if (*from < *to) ++from;
+						else if (*to < *from) ++to;
+						else { ++sharedNeighbours; ++from; ++to; }
+					}
+					if (sharedNeighbours > edgeCorners.size()) continue;
+
+					// two ends with three neighbours each are a tetrahedron, it would fold into one triangle seen from both sides
+					if (fromNeighbours.size() <= 3 && toNeighbours.size() <= 3) continue;
+
+					// every triangle around the removed vertex changes, none of them may change twice in one pass
+					for (uint32_t t = firstTriangles[collapse.from]; t < firstTriangles[collapse.from + 1]; ++t)
+					{
+						const uint32_t* pTriangle = indices.data() + vertexTriangles[t] * 3;
+						touched[pTriangle[0]] = true;
+						touched[pTriangle[1]] = true;
+						touched[pTriangle[2]] = true;
+					}
+
+					remap[collapse.from] = collapse.to;
+					quadrics[positionIds[collapse.to]] += quadrics[positionIds[collapse.from]];
+					resultError = std::max(resultError, collapse.error);
+					++collapseCount;
+				}
+
+				if (collapseCount == 0) break;
+
+				// collapsed edges leave triangles with two equal corners behind
+				size_t writeIndex = 0;
+				for (uint32_t triangle = 0; triangle < triangleCount; ++triangle)
+				{
+					const uint32_t a = remap[indices[triangle * 3]];
+					const uint32_t b = remap[indices[triangle * 3 + 1]];
+					const uint32_t c = remap[indices[triangle * 3 + 2]];
+					if (a == b || b == c || c == a) continue;
+
+					indices[writeIndex++] = a;
+					indices[writeIndex++] = b;
+					indices[writeIndex++] = c;
+				}
+				indices.resize(writeIndex);
+			}
+
+			return std::sqrt(resultError);
+		}
+
+		std::vector<Mesh> BuildLods(const Mesh& mesh, const std::vector<float>& relativeErrors)
+		{
+			std::vector<Mesh> lods;
+			if (mesh.vertices.empty()) return lods;
+
+			const float radius = mesh.boundingSphere.radius;
+
+			size_t previousIndexCount = mesh.indices.size();
+			for (const float relativeError : relativeErrors)
+			{
+				Mesh lod{};
+				lod.primitiveTopology = mesh.primitiveTopology;
+				lod.indices = mesh.indices;
+				lod.lodError = Simplify(mesh.vertices, lod.indices, 0, relativeError * radius);
+
+				if (lod.indices.size() >= previousIndexCount) continue;
+				previousIndexCount = lod.indices.size();
+
+				// only the vertices the coarser triangles still use, in the order they use them
+				constexpr uint32_t unused = std::numeric_limits<uint32_t>::max();
+				std::vector<uint32_t> newIndices(mesh.vertices.size(), unused);
+				for (uint32_t& index : lod.indices)
+				{
+					if (newIndices[index] == unused)
+					{
+						newIndices[index] = static_cast<uint32_t>(lod.vertices.size());
+						lod.vertices.push_back(mesh.vertices[index]);
+					}
+					index = newIndices[index];
+				}
+				lod.ComputeBounds();
+
+				lods.push_back(std::move(lod));
+			}
+
+			return lods;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Load time level of detail generation for indexed triangle lists, by quadric error edge collapses.
+	// Vertices only ever collapse onto a neighbour, so the uvs, normals and tangents that are left stay exactly as loaded.
+	// Vertices on uv or normal seams and on open borders are never removed, that keeps the texture and the outline intact.
+	// Collapses that would turn a triangle over or pinch the surface so an edge ends up with more than two triangles are skipped.
+	namespace MeshSimplifier
+	{
+		// Removes vertices until only targetIndexCount indices are left or the next collapse would move
+		// the surface further than targetError. The error is a distance in the units of the positions.
+		// Returns the largest error of any collapse that was done.
+		float Simplify(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, size_t targetIndexCount, float targetError);
+
+		// One coarser mesh for every entry of relativeErrors, each simplified from the full mesh as far as that error allows.
+		// The errors are relative to the bounding sphere radius, so the bounds of mesh have to be computed already.
+		// The levels store theirs in lodError as a distance. Levels that come out no smaller than the previous one are dropped.
+		// Only vertices, indices and bounds are filled in, the unused vertices are removed.
+		std::vector<Mesh> BuildLods(const Mesh& mesh, const std::vector<float>& relativeErrors);
+	}
+}
@@ -1,96 +1,298 @@
 #include "Texture.h"
 #include "Vector3.h"
 #include "Vector2.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <SDL_image.h>
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface) :
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ (uint32_t*)pSurface->pixels }
+	namespace
 	{
+		// byte to [0, 1], the same values dividing by 255 gives
+		constexpr std::array<float, 256> MakeByteToFloat()
+		{
+			std::array<float, 256> table{};
+			for (int i = 0; i < 256; ++i)
+			{
+				table[i] = static_cast<float>(i) / 255.0f;
+			}
+			return table;
+		}
+
+		constexpr std::array<float, 256> byteToFloat{ MakeByteToFloat() };
 	}
 
-	Texture::~Texture()
+	Texture::Texture(SDL_Surface* pSurface, TextureFormat format)
 	{
-		if (m_pSurface)
+		if (!pSurface) return;
+
+		// whatever format the image came in, it is read through SDL exactly once here
+		SDL_Surface* pConverted = SDL_ConvertSurfaceFormat(pSurface, SDL_PIXELFORMAT_RGBA32, 0);
+		if (!pConverted) return;
+
+		const size_t texelCount = BuildMipLevels(pConverted->w, pConverted->h);
+		if (format == TextureFormat::Color)
+		{
+			m_Texels.resize(texelCount);
+		}
+		else
+		{
+			m_Normals.resize(texelCount);
+		}
+
+		const MipLevel& base = m_Levels.front();
+		for (int y = 0; y < base.height; ++y)
 		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
+			const uint32_t* pRow = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(pConverted->pixels) + y * pConverted->pitch);
+
+			for (int x = 0; x < base.width; ++x)
+			{
+				Uint8 r, g, b, a;
+				SDL_GetRGBA(pRow[x], pConverted->format, &r, &g, &b, &a);
+
+				const size_t index = TexelIndex(base, x, y);
+				if (format == TextureFormat::Color)
+				{
+					m_Texels[index] = { r, g, b, a };
+				}
+				else
+				{
+					m_Normals[index] = Vector3
+					{
+						byteToFloat[r] * 2 - 1,
+						byteToFloat[g] * 2 - 1,
+						byteToFloat[b] * 2 - 1
+					};
+				}
+			}
+		}
+
+		SDL_FreeSurface(pConverted);
+
+		// every level is a 2x2 box filter of the one above, an odd last row or column is repeated
+		for (size_t levelIndex = 1; levelIndex < m_Levels.size(); ++levelIndex)
+		{
+			const MipLevel& source = m_Levels[levelIndex - 1];
+			const MipLevel& target = m_Levels[levelIndex];
+
+			for (int y = 0; y < target.height; ++y)
+			{
+				const int y0 = std::min(2 * y, source.height - 1);
+				const int y1 = std::min(2 * y + 1, source.height - 1);
+
+				for (int x = 0; x < target.width; ++x)
+				{
+					const int x0 = std::min(2 * x, source.width - 1);
+					const int x1 = std::min(2 * x + 1, source.width - 1);
+
+					const size_t corners[4]
+					{
+						TexelIndex(source, x0, y0), TexelIndex(source, x1, y0),
+						TexelIndex(source, x0, y1), TexelIndex(source, x1, y1)
+					};
+
+					if (format == TextureFormat::Color)
+					{
+						const auto average = [&](uint8_t Rgba8::* pChannel)
+							{
+								int sum = 2;
+								for (const size_t corner : corners)
+								{
+									sum += m_Texels[corner].*pChannel;
+								}
+								return static_cast<uint8_t>(sum / 4);
+							};
+
+						m_Texels[TexelIndex(target, x, y)] = { average(&Rgba8::r), average(&Rgba8::g), average(&Rgba8::b), average(&Rgba8::a) };
+					}
+					else
+					{
+						// averaging shortens the vectors where the surface bends, so they are brought back to unit length
+						Vector3 normal{};
+						for (const size_t corner : corners)
+						{
+							normal += m_Normals[corner];
+						}
+						if (normal.SqrMagnitude() > 0.f)
+						{
+							normal.Normalize();
+						}
+						m_Normals[TexelIndex(target, x, y)] = normal;
+					}
+				}
+			}
 		}
 	}
 
-	Texture* Texture::LoadFromFile(const std::string& path)
+	Texture* Texture::LoadFromFile(const std::string& path, TextureFormat format)
 	{
-		//TODO
-		
-		 SDL_Surface* pSurface = IMG_Load(path.c_str());
-		
-		 Texture* textureObject = new Texture(pSurface);
-		//Load SDL_Surface using IMG_LOAD
-		//Create & Return a new Texture Object (using SDL_Surface)
+		SDL_Surface* pSurface = IMG_Load(path.c_str());
+
+		Texture* textureObject = new Texture(pSurface, format);
+
+		if (pSurface)
+		{
+			SDL_FreeSurface(pSurface);
+		}
 
 		return textureObject;
 	}
-	ColorRGB Texture::Sample(const Vector2& uv) const
+
+	size_t Texture::BuildMipLevels(int width, int height)
 	{
-		// Ensure that the texture has a valid surface
-		if (!m_pSurface)
+		size_t texelCount = 0;
+		while (true)
 		{
-			// Handle error or return a default color
-			return ColorRGB(0.0f, 0.0f, 0.0f);
+			const int tilesPerRow = (width + TileMask) >> TileShift;
+			const int tileRows = (height + TileMask) >> TileShift;
+
+			m_Levels.push_back({ width, height, tilesPerRow, texelCount });
+			texelCount += static_cast<size_t>(tilesPerRow) * tileRows * TileSize * TileSize;
+
+			if (width == 1 && height == 1) break;
+			width = std::max(1, width / 2);
+			height = std::max(1, height / 2);
 		}
+		return texelCount;
+	}
+
+	size_t Texture::RowOffset(const MipLevel& level, int y)
+	{
+		const size_t tileRow = static_cast<size_t>(y >> TileShift) * level.tilesPerRow * TexelsPerTile;
+		return level.offset + tileRow + ((y & TileMask) << TileShift);
+	}
+
+	size_t Texture::ColumnOffset(int x)
+	{
+		return static_cast<size_t>(x >> TileShift) * TexelsPerTile + (x & TileMask);
+	}
+
+	size_t Texture::TexelIndex(const MipLevel& level, int x, int y) const
+	{
+		return RowOffset(level, y) + ColumnOffset(x);
+	}
+
+	size_t Texture::TexelIndex(const Vector2& uv) const
+	{
+		const MipLevel& base = m_Levels.front();
 
 		// Convert UV coordinates to pixel coordinates
-		int x = static_cast<int>(uv.x * m_pSurface->w);
-		int y = static_cast<int>(uv.y * m_pSurface->h);
+		int x = static_cast<int>(uv.x * base.width);
+		int y = static_cast<int>(uv.y * base.height);
 
 		// Clamp pixel coordinates to valid range
-		x = std::max(0, std::min(x, m_pSurface->w - 1));
-		y = std::max(0, std::min(y, m_pSurface->h - 1));
+		x = std::max(0, std::min(x, base.width - 1));
+		y = std::max(0, std::min(y, base.height - 1));
+
+		return TexelIndex(base, x, y);
+	}
+
+	float Texture::ComputeLod(const Vector2& ddx, const Vector2& ddy) const
+	{
+		const MipLevel& base = m_Levels.front();
+		const float width = static_cast<float>(base.width);
+		const float height = static_cast<float>(base.height);
+
+		// texels crossed per pixel along the faster of the two screen axes, squared so only one log is needed
+		const float lengthX = ddx.x * ddx.x * width * width + ddx.y * ddx.y * height * height;
+		const float lengthY = ddy.x * ddy.x * width * width + ddy.y * ddy.y * height * height;
+
+		return 0.5f * std::log2(std::max(lengthX, lengthY));
+	}
+
+	template<typename Texel, typename Decode>
+	auto Texture::SampleTrilinear(const TexelBuffer<Texel>& texels, const Vector2& uv, float lod, Decode&& decode) const
+	{
+		// texel centres sit at half coordinates, outside the texture the edge texels repeat
+		const auto bilinear = [&](const MipLevel& level)
+			{
+				const float x = uv.x * static_cast<float>(level.width) - 0.5f;
+				const float y = uv.y * static_cast<float>(level.height) - 0.5f;
+				const float floorX = std::floor(x);
+				const float floorY = std::floor(y);
+				const float fractionX = x - floorX;
+				const float fractionY = y - floorY;
+
+				const int x0 = std::clamp(static_cast<int>(floorX), 0, level.width - 1);
+				const int x1 = std::clamp(static_cast<int>(floorX) + 1, 0, level.width - 1);
+				const int y0 = std::clamp(static_cast<int>(floorY), 0, level.height - 1);
+				const int y1 = std::clamp(static_cast<int>(floorY) + 1, 0, level.height - 1);
+
+				const size_t row0 = RowOffset(level, y0);
+				const size_t row1 = RowOffset(level, y1);
+				const size_t column0 = ColumnOffset(x0);
+				const size_t column1 = ColumnOffset(x1);
+
+				const auto top0 = decode(texels[row0 + column0]);
+				const auto top1 = decode(texels[row0 + column1]);
+				const auto bottom0 = decode(texels[row1 + column0]);
+				const auto bottom1 = decode(texels[row1 + column1]);
+
+				const auto top = top0 + (top1 - top0) * fractionX;
+				const auto bottom = bottom0 + (bottom1 - bottom0) * fractionX;
+				return top + (bottom - top) * fractionY;
+			};
+
+		// magnified pixels stay on the full resolution level, minified ones blend the two closest levels,
+		// the order of the max also sends a nan lod to the full resolution
+		lod = std::min(std::max(0.f, lod), static_cast<float>(m_Levels.size() - 1));
+		const int lower = static_cast<int>(lod);
+		const float fraction = lod - static_cast<float>(lower);
+
+		const auto lowerSample = bilinear(m_Levels[lower]);
+		if (fraction <= 0.f) return lowerSample;
 
-		// Calculate the index of the pixel in the single array
-		const uint32_t pixel = m_pSurfacePixels[y * m_pSurface->w + x];
-		// Read the color of the pixel
-		Uint8 r, g, b;
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
+		const auto upperSample = bilinear(m_Levels[lower + 1]);
+		return lowerSample + (upperSample - lowerSample) * fraction;
+	}
 
-		// Remap color values to [0, 1] range
-		float normalizedR = static_cast<float>(r) / 255.0f;
-		float normalizedG = static_cast<float>(g) / 255.0f;
-		float normalizedB = static_cast<float>(b) / 255.0f;
+	ColorRGB Texture::Sample(const Vector2& uv) const
+	{
+		if (m_Texels.empty())
+		{
+			return ColorRGB(0.0f, 0.0f, 0.0f);
+		}
 
-		return ColorRGB(normalizedR, normalizedG, normalizedB);
+		const Rgba8 texel = m_Texels[TexelIndex(uv)];
+		return ColorRGB(byteToFloat[texel.r], byteToFloat[texel.g], byteToFloat[texel.b]);
 	}
+
 	Vector3 Texture::SampleNormalMap(const Vector2& uv) const
 	{
-		// Ensure that the texture has a valid surface
-		if (!m_pSurface)
+		if (m_Normals.empty())
 		{
-			// Handle error or return a default color
 			return Vector3(0.0f, 0.0f, 0.0f);
 		}
 
-		// Convert UV coordinates to pixel coordinates
-		int x = static_cast<int>(uv.x * m_pSurface->w);
-		int y = static_cast<int>(uv.y * m_pSurface->h);
+		return m_Normals[TexelIndex(uv)];
+	}
 
-		// Clamp pixel coordinates to valid range
-		x = std::max(0, std::min(x, m_pSurface->w - 1));
-		y = std::max(0, std::min(y, m_pSurface->h - 1));
+	ColorRGB Texture::SampleGrad(const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		if (m_Texels.empty())
+		{
+			return ColorRGB(0.0f, 0.0f, 0.0f);
+		}
 
-		// Calculate the index of the pixel in the single array
-		const uint32_t pixel = m_pSurfacePixels[y * m_pSurface->w + x];
-		// Read the color of the pixel
-		Uint8 r, g, b;
-		SDL_GetRGB(pixel, m_pSurface->format, &r, &g, &b);
+		return SampleTrilinear(m_Texels, uv, ComputeLod(ddx, ddy), [](const Rgba8& texel)
+			{
+				return ColorRGB(byteToFloat[texel.r], byteToFloat[texel.g], byteToFloat[texel.b]);
+			});
+	}
 
-		// Remap color values to [0, 1] range
-		float normalizedR = ((static_cast<float>(r) / 255.0f) * 2) - 1;
-		float normalizedG = ((static_cast<float>(g) / 255.0f) * 2) - 1;
-		float normalizedB = ((static_cast<float>(b) / 255.0f) * 2) - 1;
+	Vector3 Texture::SampleNormalMapGrad(const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const
+	{
+		if (m_Normals.empty())
+		{
+			return Vector3(0.0f, 0.0f, 0.0f);
+		}
 
-		return Vector3(normalizedR,normalizedG,normalizedB);
+		return SampleTrilinear(m_Normals, uv, ComputeLod(ddx, ddy), [](const Vector3& normal)
+			{
+				return normal;
+			});
 	}
 
-}
\ No newline at end of file
+}
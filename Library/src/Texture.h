@@ -1,20 +1,39 @@
 #pragma once
-#include <SDL_surface.h>
+#include <cstdint>
+#include <new>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
 #include "Vector3.h"
+
+struct SDL_Surface;
+
 namespace dae
 {
 	struct Vector2;
 
+	// What the texels are converted to when loading, decided by how the texture gets sampled
+	enum class TextureFormat
+	{
+		// 8 bits per channel, read with Sample and SampleGrad
+		Color,
+		// a float vector in [-1, 1] per texel, read with SampleNormalMap and SampleNormalMapGrad
+		NormalMap
+	};
+
 	class Texture
 	{
 	public:
-		~Texture();
-
-		static Texture* LoadFromFile(const std::string& path);
+		static Texture* LoadFromFile(const std::string& path, TextureFormat format = TextureFormat::Color);
+		// nearest texel of the full resolution level, black when the texture failed to load or is a normal map
 		ColorRGB Sample(const Vector2& uv) const;
+		// nearest texel of the full resolution level, zero when the texture failed to load or is not a normal map
 		Vector3 SampleNormalMap(const Vector2& uv) const;
+
+		// Trilinear, the mip level follows from how fast uv changes per pixel, ddx along the row and ddy down the column.
+		// Same results as the nearest versions when the texture is empty or has the other format.
+		ColorRGB SampleGrad(const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
+		Vector3 SampleNormalMapGrad(const Vector2& uv, const Vector2& ddx, const Vector2& ddy) const;
 		class ReadEmptytexture : public std::exception
 		{
 		public:
@@ -24,9 +43,74 @@ namespace dae
 			}
 		};
 	private:
-		Texture(SDL_Surface* pSurface);
+		// the surface is converted and can be freed afterwards
+		Texture(SDL_Surface* pSurface, TextureFormat format);
+
+		// Texels are stored in square tiles of TileSize by TileSize, the tiles row by row and the texels
+		// inside a tile row by row too. An 8x8 tile of Rgba8 is four cache lines of two tile rows each, so a bilinear
+		// footprint mostly stays in one line and walking along v touches about as many lines as walking along u.
+		static constexpr int TileShift{ 3 };
+		static constexpr int TileSize{ 1 << TileShift };
+		static constexpr int TileMask{ TileSize - 1 };
+		static constexpr int TexelsPerTile{ TileSize * TileSize };
+
+		// starts the texels on a cache line, levels are whole tiles so every tile starts on one too
+		template<typename T>
+		struct CacheLineAllocator
+		{
+			using value_type = T;
+			static constexpr std::align_val_t alignment{ 64 };
+
+			CacheLineAllocator() = default;
+			template<typename U>
+			CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+			T* allocate(size_t count) { return static_cast<T*>(::operator new(count * sizeof(T), alignment)); }
+			void deallocate(T* p, size_t) { ::operator delete(p, alignment); }
+
+			template<typename U>
+			bool operator==(const CacheLineAllocator<U>&) const { return true; }
+		};
+
+		template<typename Texel>
+		using TexelBuffer = std::vector<Texel, CacheLineAllocator<Texel>>;
+
+		// every level is half the size of the one before it down to 1x1, they are stored one after the other,
+		// each padded to whole tiles
+		struct MipLevel
+		{
+			int width;
+			int height;
+			int tilesPerRow;
+			size_t offset;
+		};
+
+		// sizes every level for a base of width by height and returns the texel count of the whole chain, padding included
+		size_t BuildMipLevels(int width, int height);
+		// the tiled index is a part only y decides plus a part only x decides,
+		// so neighbouring texels of a bilinear footprint share them
+		static size_t RowOffset(const MipLevel& level, int y);
+		static size_t ColumnOffset(int x);
+		size_t TexelIndex(const MipLevel& level, int x, int y) const;
+		// nearest texel of the full resolution level, uv is clamped to the edges
+		size_t TexelIndex(const Vector2& uv) const;
+		// level of detail where one texel covers about one pixel, 0 is the full resolution
+		float ComputeLod(const Vector2& ddx, const Vector2& ddy) const;
+
+		template<typename Texel, typename Decode>
+		auto SampleTrilinear(const TexelBuffer<Texel>& texels, const Vector2& uv, float lod, Decode&& decode) const;
+
+		struct Rgba8
+		{
+			uint8_t r;
+			uint8_t g;
+			uint8_t b;
+			uint8_t a;
+		};
 
-		SDL_Surface* m_pSurface{ nullptr };
-		uint32_t* m_pSurfacePixels{ nullptr };
+		std::vector<MipLevel> m_Levels{};
+		// only the one matching the format is filled
+		TexelBuffer<Rgba8> m_Texels{};
+		TexelBuffer<Vector3> m_Normals{};
 	};
-}
\ No newline at end of file
+}
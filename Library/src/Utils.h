@@ -1,6 +1,8 @@
 #pragma once
 #include <cassert>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
 #include "Maths.h"
 #include "DataTypes.h"
 
@@ -10,72 +12,48 @@ namespace dae
 {
 	namespace Utils
 	{
-
-		bool IsPixelInterpolated(const Vertex_Out& v0, const Vertex_Out& v1, const Vertex_Out& v2, Vertex_Out& pixelVector, Vector2& uvInterpolated, float& pixelDepth)
+		// Face corners with the same position, uv and normal become one vertex
+		struct VertexKey
 		{
-			const Vector2 edge = v1.position.GetXY() - v0.position.GetXY();// V1 - V0
-			const Vector2 edge1 = v2.position.GetXY() - v1.position.GetXY();// V2 - V1
-			const Vector2 edge2 = v0.position.GetXY() - v2.position.GetXY();
-
-			const Vector2 pointToVertex = pixelVector.position.GetXY() - v0.position.GetXY();// P - V0
-			const Vector2 pointToVertex1 = pixelVector.position.GetXY() - v1.position.GetXY();// P - V1
-			const Vector2 pointToVertex2 = pixelVector.position.GetXY() - v2.position.GetXY();// P - V2
-
-			// Calculate 2D cross products (signed areas)
-
-			float cross1 = Vector2::Cross(pointToVertex2, edge2);	if (cross1 >= 0) return false;
-
-			float cross0 = Vector2::Cross(pointToVertex1, edge1);	if (cross0 >= 0) return false;
-
-			float cross2 = Vector2::Cross(pointToVertex, edge);	if (cross2 >= 0) return false;
-
-			// Check the signs of the cross products
-
-			const float totalParallelogramArea = cross0 + cross1 + cross2;
-
-			const float W0 = cross0 / totalParallelogramArea;
-			const float W1 = cross1 / totalParallelogramArea;
-			const float W2 = cross2 / totalParallelogramArea;
-
-			//interpolate through the depth values
-			pixelDepth = 1 /
-				(W0 / v0.position.z +
-					W1 / v1.position.z +
-					W2 / v2.position.z);
-
-			if (pixelDepth < 0 || pixelDepth > 1) return false;// culling
-
-			//interpolate through the depth values
-
-			float interpolatedDepth = 1 /
-				(W0 / v0.position.w +
-					W1 / v1.position.w +
-					W2 / v2.position.w);
-
-			uvInterpolated = (v0.uv * W0 / v0.position.w +
-				v1.uv * W1 / v1.position.w +
-				v2.uv * W2 / v2.position.w) * interpolatedDepth;
+			Vector3 position{};
+			Vector2 uv{};
+			Vector3 normal{};
 
-			pixelVector.normal = (v0.normal * W0 / v0.position.w +
-				v1.normal * W1 / v1.position.w +
-				v2.normal * W2 / v2.position.w) * interpolatedDepth;
-			pixelVector.normal.Normalize();
+			// exact on purpose, the epsilon compare of the vector types would not agree with the hash
+			bool operator==(const VertexKey& other) const
+			{
+				return position.x == other.position.x && position.y == other.position.y && position.z == other.position.z
+					&& uv.x == other.uv.x && uv.y == other.uv.y
+					&& normal.x == other.normal.x && normal.y == other.normal.y && normal.z == other.normal.z;
+			}
+		};
 
-			pixelVector.color = (v0.color * W0 / v0.position.w +
-				v1.color * W1 / v1.position.w +
-				v2.color * W2 / v2.position.w) * interpolatedDepth;
+		// FNV-1a over the bits of exactly compared floats, -0 and 0 compare equal so they have to hash the same
+		inline size_t HashFloats(const float* pComponents, size_t count)
+		{
+			size_t hash = 14695981039346656037ull;
+			for (size_t i = 0; i < count; ++i)
+			{
+				float component = pComponents[i];
+				if (component == 0.f) component = 0.f;
 
-			pixelVector.tangent = (v0.tangent * W0 / v0.position.w +
-				v1.tangent * W1 / v1.position.w +
-				v2.tangent * W2 / v2.position.w) * interpolatedDepth;
+				uint32_t bits;
+				std::memcpy(&bits, &component, sizeof(bits));
 
-			pixelVector.viewDirection = (v0.viewDirection * W0 / v0.position.w +
-				v1.viewDirection * W1 / v1.position.w +
-				v2.viewDirection * W2 / v2.position.w) * interpolatedDepth;
+				hash = (hash ^ bits) * 1099511628211ull;
+			}
 
-			return true;
+			return hash;
 		}
 
+		struct VertexKeyHash
+		{
+			size_t operator()(const VertexKey& key) const
+			{
+				const float components[8]{ key.position.x, key.position.y, key.position.z, key.uv.x, key.uv.y, key.normal.x, key.normal.y, key.normal.z };
+				return HashFloats(components, 8);
+			}
+		};
 
 		//Just parses vertices and indices
 #pragma warning(push)
@@ -101,6 +79,9 @@ namespace dae
 			vertices.clear();
 			indices.clear();
 
+			// index of the vertex every distinct corner got welded into
+			std::unordered_map<VertexKey, uint32_t, VertexKeyHash> weldedVertices{};
+
 			std::string sCommand;
 			// start a while iteration ending when the end of file is reached (ios::eof)
 			while (!file.eof())
@@ -174,9 +155,13 @@ namespace dae
 							}
 						}
 
-						vertices.push_back(vertex);
-						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
-						//indices.push_back(uint32_t(vertices.size()) - 1);
+						// corners shared between faces are emitted once, so they are transformed once as well
+						const auto [it, isNew] = weldedVertices.try_emplace(VertexKey{ vertex.position, vertex.uv, vertex.normal }, uint32_t(vertices.size()));
+						if (isNew)
+						{
+							vertices.push_back(vertex);
+						}
+						tempIndices[iFace] = it->second;
 					}
 
 					indices.push_back(tempIndices[0]);
@@ -215,6 +200,10 @@ namespace dae
 				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
 				float r = 1.f / Vector2::Cross(diffX, diffY);
 
+				// welded vertices sum up the tangents of all their triangles,
+				// one without a uv area would turn every one of them into nan
+				if (!std::isfinite(r)) continue;
+
 				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
 				vertices[index0].tangent += tangent;
 				vertices[index1].tangent += tangent;
@@ -0,0 +1,98 @@
+#include "Clipping.h"
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		// positive inside the plane, negative outside of it
+		float PlaneDistance(int plane, const Vector4& position, const GuardBand& guardBand)
+		{
+			switch (plane)
+			{
+			case 0: return position.z;
+			case 1: return position.w - position.z;
+			case 2: return guardBand.x * position.w + position.x;
+			case 3: return guardBand.x * position.w - position.x;
+			case 4: return guardBand.y * position.w + position.y;
+			default: return guardBand.y * position.w - position.y;
+			}
+		}
+
+		Vertex_Out LerpVertex(const Vertex_Out& v0, const Vertex_Out& v1, float t)
+		{
+			return Vertex_Out
+			{
+				v0.position + (v1.position - v0.position) * t,
+				ColorRGB::Lerp(v0.color, v1.color, t),
+				v0.uv + (v1.uv - v0.uv) * t,
+				v0.normal + (v1.normal - v0.normal) * t,
+				v0.tangent + (v1.tangent - v0.tangent) * t,
+				v0.viewDirection + (v1.viewDirection - v0.viewDirection) * t
+			};
+		}
+	}
+
+	uint32_t ComputeOutcode(const Vector4& position, const GuardBand& guardBand)
+	{
+		uint32_t outcode{};
+		for (int plane = 0; plane < ClipPlanes::Count; ++plane)
+		{
+			if (PlaneDistance(plane, position, guardBand) < 0) outcode |= 1 << plane;
+		}
+
+		return outcode;
+	}
+
+	bool ClipTriangle(const Triangle4& triangle, uint32_t planes, const GuardBand& guardBand, ClippedPolygon& result)
+	{
+		ClippedPolygon scratch;
+
+		ClippedPolygon* pIn = &result;
+		ClippedPolygon* pOut = &scratch;
+
+		pIn->vertices[0] = triangle.vertex0;
+		pIn->vertices[1] = triangle.vertex1;
+		pIn->vertices[2] = triangle.vertex2;
+		pIn->vertexCount = 3;
+
+		for (int plane = 0; plane < ClipPlanes::Count; ++plane)
+		{
+			if (!(planes & (1 << plane))) continue;
+
+			pOut->vertexCount = 0;
+
+			// walk every edge, keep the inside vertices and add one where the edge crosses the plane
+			for (int i = 0; i < pIn->vertexCount; ++i)
+			{
+				const Vertex_Out& current = pIn->vertices[i];
+				const Vertex_Out& next = pIn->vertices[(i + 1) % pIn->vertexCount];
+
+				const float currentDistance = PlaneDistance(plane, current.position, guardBand);
+				const float nextDistance = PlaneDistance(plane, next.position, guardBand);
+
+				if (currentDistance >= 0)
+				{
+					pOut->vertices[pOut->vertexCount++] = current;
+				}
+
+				if ((currentDistance >= 0) != (nextDistance >= 0))
+				{
+					const float t = currentDistance / (currentDistance - nextDistance);
+					pOut->vertices[pOut->vertexCount++] = LerpVertex(current, next, t);
+				}
+			}
+
+			std::swap(pIn, pOut);
+			if (pIn->vertexCount < 3) return false;
+		}
+
+		// an odd number of active planes leaves the polygon in the scratch buffer
+		if (pIn != &result)
+		{
+			result = *pIn;
+		}
+
+		return true;
+	}
+}
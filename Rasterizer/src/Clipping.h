@@ -0,0 +1,48 @@
+#pragma once
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Planes of the clip volume the projection matrix maps the view frustum to:
+	// -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	// Used as bit masks, a triangle only has to be clipped against the planes one of its vertices is outside of.
+	namespace ClipPlanes
+	{
+		constexpr uint32_t Near{ 1 << 0 };
+		constexpr uint32_t Far{ 1 << 1 };
+		constexpr uint32_t Left{ 1 << 2 };
+		constexpr uint32_t Right{ 1 << 3 };
+		constexpr uint32_t Bottom{ 1 << 4 };
+		constexpr uint32_t Top{ 1 << 5 };
+
+		constexpr int Count{ 6 };
+		constexpr uint32_t Depth{ Near | Far };
+		constexpr uint32_t All{ (1 << Count) - 1 };
+	}
+
+	// Scale of the side planes relative to the viewport. Pushing them out lets the rasterizer
+	// take triangles that hang over the screen border as they are, its bounding box clamp does the scissoring.
+	struct GuardBand
+	{
+		float x{ 1.f };
+		float y{ 1.f };
+	};
+
+	// Whatever is left of a triangle after clipping, every plane adds at most one vertex
+	struct ClippedPolygon
+	{
+		static constexpr int MaxVertexCount{ 3 + ClipPlanes::Count };
+
+		Vertex_Out vertices[MaxVertexCount]{};
+		int vertexCount{};
+	};
+
+	// one bit for every plane the clip space position lies outside of, with the side planes moved to the guard band
+	uint32_t ComputeOutcode(const Vector4& position, const GuardBand& guardBand = {});
+
+	// Sutherland-Hodgman in homogeneous clip space against every plane in planes.
+	// Attributes are interpolated linearly before the divide, so they stay perspective correct.
+	// Returns false when nothing of the triangle is left.
+	bool ClipTriangle(const Triangle4& triangle, uint32_t planes, const GuardBand& guardBand, ClippedPolygon& result);
+}
@@ -0,0 +1,76 @@
+#include "HierarchicalDepth.h"
+#include <algorithm>
+#include <cfloat>
+
+namespace dae
+{
+	void HierarchicalDepth::Resize(int width, int height)
+	{
+		m_Width = width;
+		m_Height = height;
+		m_BlockCountX = (width + BlockSize - 1) / BlockSize;
+		m_BlockCountY = (height + BlockSize - 1) / BlockSize;
+
+		m_MaxDepth.assign(m_BlockCountX * m_BlockCountY, FLT_MAX);
+		m_Dirty.assign(m_BlockCountX * m_BlockCountY, false);
+	}
+
+	void HierarchicalDepth::Clear(const TileRect& rect, float depth)
+	{
+		const int lastBlockX = (rect.maxX - 1) / BlockSize;
+		const int lastBlockY = (rect.maxY - 1) / BlockSize;
+
+		for (int blockY = rect.minY / BlockSize; blockY <= lastBlockY; ++blockY)
+		{
+			for (int blockX = rect.minX / BlockSize; blockX <= lastBlockX; ++blockX)
+			{
+				const int blockIndex = blockX + blockY * m_BlockCountX;
+				m_MaxDepth[blockIndex] = depth;
+				m_Dirty[blockIndex] = false;
+			}
+		}
+	}
+
+	float HierarchicalDepth::GetMaxDepth(const TileRect& rect) const
+	{
+		const int lastBlockX = (rect.maxX - 1) / BlockSize;
+		const int lastBlockY = (rect.maxY - 1) / BlockSize;
+
+		float maxDepth = 0.f;
+		for (int blockY = rect.minY / BlockSize; blockY <= lastBlockY; ++blockY)
+		{
+			for (int blockX = rect.minX / BlockSize; blockX <= lastBlockX; ++blockX)
+			{
+				maxDepth = std::max(maxDepth, m_MaxDepth[blockX + blockY * m_BlockCountX]);
+			}
+		}
+
+		return maxDepth;
+	}
+
+	float HierarchicalDepth::GetBlockMaxDepth(int blockX, int blockY, const float* pDepthBuffer)
+	{
+		const int blockIndex = blockX + blockY * m_BlockCountX;
+		if (!m_Dirty[blockIndex]) return m_MaxDepth[blockIndex];
+
+		const int minX = blockX * BlockSize;
+		const int minY = blockY * BlockSize;
+		const int maxX = std::min(minX + BlockSize, m_Width);
+		const int maxY = std::min(minY + BlockSize, m_Height);
+
+		float maxDepth = 0.f;
+		for (int py = minY; py < maxY; ++py)
+		{
+			const float* pRow = pDepthBuffer + py * m_Width;
+			for (int px = minX; px < maxX; ++px)
+			{
+				maxDepth = std::max(maxDepth, pRow[px]);
+			}
+		}
+
+		m_MaxDepth[blockIndex] = maxDepth;
+		m_Dirty[blockIndex] = false;
+
+		return maxDepth;
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "TriangleSetup.h"
+
+namespace dae
+{
+	// Coarse level on top of the depth buffer holding the farthest depth of every 8x8 block.
+	// A block that got written to is only marked dirty, its maximum is recomputed the next
+	// time somebody needs an exact value. Until then the stored value is an upper bound,
+	// which is still safe to reject against because depth only ever gets closer.
+	class HierarchicalDepth final
+	{
+	public:
+		static constexpr int BlockSize{ 8 };
+
+		void Resize(int width, int height);
+
+		// resets every block overlapping rect, rect has to be aligned to BlockSize
+		void Clear(const TileRect& rect, float depth);
+
+		// upper bound for every depth inside rect, never touches the depth buffer
+		float GetMaxDepth(const TileRect& rect) const;
+
+		// exact maximum of one block, refreshed from the depth buffer when it is dirty
+		float GetBlockMaxDepth(int blockX, int blockY, const float* pDepthBuffer);
+
+		void MarkDirty(int blockX, int blockY) { m_Dirty[blockX + blockY * m_BlockCountX] = true; }
+
+	private:
+		int m_Width{};
+		int m_Height{};
+		int m_BlockCountX{};
+		int m_BlockCountY{};
+
+		std::vector<float> m_MaxDepth;
+		std::vector<uint8_t> m_Dirty;
+	};
+}
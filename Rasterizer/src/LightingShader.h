@@ -0,0 +1,188 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+#include "DataTypes.h"
+#include "Maths.h"
+#include "Shader.h"
+#include "Texture.h"
+
+namespace dae
+{
+	enum class LightingMode
+	{
+		ObservedArea,
+		Diffuse,
+		Specular,
+		Combined
+	};
+
+	// the possible varyings of LightingShader, colour is never used so it is never interpolated,
+	// uv always comes first so its derivatives are the first two
+	struct NormalVaryings
+	{
+		Vector3 normal;
+	};
+
+	struct SurfaceVaryings
+	{
+		Vector2 uv;
+		Vector3 normal;
+	};
+
+	struct TangentSurfaceVaryings
+	{
+		Vector2 uv;
+		Vector3 normal;
+		Vector3 tangent;
+	};
+
+	struct SpecularVaryings
+	{
+		Vector2 uv;
+		Vector3 normal;
+		Vector3 viewDirection;
+	};
+
+	struct TangentSpecularVaryings
+	{
+		Vector2 uv;
+		Vector3 normal;
+		Vector3 tangent;
+		Vector3 viewDirection;
+	};
+
+	// The directional light the vehicle is lit with, one program per lighting mode and normal map setting.
+	// Each only interpolates and fetches what its mode needs.
+	template<LightingMode Mode, bool NormalMapped>
+	struct LightingShader
+	{
+		static constexpr bool NeedsViewDirection{ Mode == LightingMode::Specular || Mode == LightingMode::Combined };
+		static constexpr bool NeedsUv{ NormalMapped || Mode != LightingMode::ObservedArea };
+
+		using Varyings = std::conditional_t<NeedsViewDirection,
+			std::conditional_t<NormalMapped, TangentSpecularVaryings, SpecularVaryings>,
+			std::conditional_t<NormalMapped, TangentSurfaceVaryings,
+				std::conditional_t<NeedsUv, SurfaceVaryings, NormalVaryings>>>;
+
+		// derivatives of uv pick the mip level of every texture fetch
+		static constexpr int DerivativeCount{ NeedsUv ? 2 : 0 };
+		using Derivatives = AttributeDerivatives<DerivativeCount>;
+
+		static Varyings Vertex(const Vertex_Out& vertex)
+		{
+			Varyings out{};
+			out.normal = vertex.normal;
+			if constexpr (NeedsUv) out.uv = vertex.uv;
+			if constexpr (NormalMapped) out.tangent = vertex.tangent;
+			if constexpr (NeedsViewDirection) out.viewDirection = vertex.viewDirection;
+			return out;
+		}
+
+		ColorRGB Pixel(const Varyings& in, const Derivatives& derivatives, const DrawCommand& draw, float) const
+		{
+			Vector2 uvDdx{};
+			Vector2 uvDdy{};
+			if constexpr (NeedsUv)
+			{
+				static_assert(offsetof(Varyings, uv) == 0, "uv has to be the first attribute");
+				uvDdx = Vector2{ derivatives.ddx[0], derivatives.ddx[1] };
+				uvDdy = Vector2{ derivatives.ddy[0], derivatives.ddy[1] };
+			}
+
+			return Lighting(in, uvDdx, uvDdy, *draw.pMaterial) * draw.tint;
+		}
+
+	private:
+		static ColorRGB Lighting(const Varyings& in, const Vector2& uvDdx, const Vector2& uvDdy, const Material& material)
+		{
+			const Vector3 lightDirection = { 0.577f, -.577f, -.577f };
+			const float lightIntensivity = 2.f;
+
+			const int shiniessValue = 25;
+
+			// interpolation shortens the normal
+			Vector3 normal = in.normal;
+			normal.Normalize();
+
+			//normal mapping
+			if constexpr (NormalMapped)
+			{
+				Vector3 binormal = Vector3::Cross(normal, in.tangent);
+				Matrix tangentSpaceAxis = Matrix{ in.tangent, binormal, normal, {0,0,0} };
+				const Vector3 sampledNormal = material.pNormal->SampleNormalMapGrad(in.uv, uvDdx, uvDdy);
+
+				normal = tangentSpaceAxis.TransformVector(sampledNormal.x, sampledNormal.y, sampledNormal.z);
+			}
+
+			const float cosAngle = Vector3::Dot(normal, lightDirection);
+
+			// black in every mode, nothing else has to be fetched
+			if (cosAngle < 0) return { 0,0,0 };
+
+			if constexpr (Mode == LightingMode::ObservedArea)
+			{
+				return ColorRGB{ cosAngle, cosAngle,cosAngle };
+			}
+			else
+			{
+				ColorRGB lambertFinalColor{};
+				if constexpr (Mode != LightingMode::Specular)
+				{
+					// lambert diffuse
+					const auto& sampledColor = material.pDiffuse->SampleGrad(in.uv, uvDdx, uvDdy);
+					const ColorRGB diffuseColor = lightIntensivity * sampledColor;
+
+					lambertFinalColor = diffuseColor / float(M_PI);
+				}
+
+				ColorRGB specularColor{};
+				if constexpr (NeedsViewDirection)
+				{
+					// phong
+					const Vector3 reflect = Vector3::Reflect(lightDirection, normal);
+					const float cosAlpha = std::max(Vector3::Dot(reflect, in.viewDirection), 0.0f);
+
+					const ColorRGB specularity = material.pSpecular->SampleGrad(in.uv, uvDdx, uvDdy);
+					float glosiness = material.pGlossiness->SampleGrad(in.uv, uvDdx, uvDdy).r;
+
+					specularColor = specularity * powf(cosAlpha, glosiness * shiniessValue) * colors::White;
+				}
+
+				if constexpr (Mode == LightingMode::Diffuse)
+				{
+					return lambertFinalColor * ColorRGB{ cosAngle, cosAngle, cosAngle };
+				}
+				else if constexpr (Mode == LightingMode::Specular)
+				{
+					return specularColor * ColorRGB{ cosAngle, cosAngle, cosAngle };
+				}
+				else
+				{
+					const ColorRGB ambientOcclusion = { 0.05f, 0.05f,0.05f };
+					return (lambertFinalColor + specularColor + ambientOcclusion) * ColorRGB(cosAngle, cosAngle, cosAngle);
+				}
+			}
+		}
+	};
+
+	// the depth buffer view, nothing is interpolated besides depth itself
+	struct DepthShader
+	{
+		struct Varyings
+		{
+		};
+
+		static Varyings Vertex(const Vertex_Out&)
+		{
+			return {};
+		}
+
+		ColorRGB Pixel(const Varyings&, const AttributeDerivatives<0>&, const DrawCommand&, float depth) const
+		{
+			const float a = Remap(depth, 0.985f, 1.f, 0.f, .8f);
+			return ColorRGB{ a, a, a };
+		}
+	};
+}
@@ -0,0 +1,281 @@
+#pragma once
+#include "Simd.h"
+#include "TriangleSetup.h"
+
+namespace dae
+{
+	// Both kernels depth test against pDepthBuffer and call pixelFunction(px, py, depth, attributes, derivatives)
+	// for every pixel that passes, attributes holds the first AttributeCount perspective correct attributes.
+	// Only those planes are evaluated, with none attributes is a null pointer and only depth is interpolated.
+	// Edges are stepped, but every plane is evaluated directly at the pixel centre with TriangleSetup::PixelX and PixelY,
+	// in the same order of operations in both kernels, so they write the same depth and pass the same attributes.
+	// derivatives holds the screen space derivatives of the first DerivativeCount attributes, laid out like
+	// TriangleSetup::Differentiate writes them, and is a null pointer without any.
+	// They return whether any depth was written.
+
+	template<int AttributeCount, int DerivativeCount, typename PixelFunction>
+	bool RasterizeScalar(const TriangleSetup& setup, const TileRect& tile, float* pDepthBuffer, int width, PixelFunction&& pixelFunction)
+	{
+		constexpr int depthPlane = static_cast<int>(Varying::Depth);
+		constexpr int inverseW = static_cast<int>(Varying::InverseW);
+		constexpr int firstAttribute = static_cast<int>(Varying::FirstAttribute);
+
+		const int minX = std::max(setup.minX, tile.minX);
+		const int maxX = std::min(setup.maxX, tile.maxX);
+		const int minY = std::max(setup.minY, tile.minY);
+		const int maxY = std::min(setup.maxY, tile.maxY);
+
+		// edges are exact integers and can be stepped with adds
+		int64_t rowEdges[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			rowEdges[i] = setup.edges[i].Evaluate(minX, minY);
+		}
+
+		bool depthWritten = false;
+
+		for (int py = minY; py < maxY; ++py)
+		{
+			int64_t edge0 = rowEdges[0];
+			int64_t edge1 = rowEdges[1];
+			int64_t edge2 = rowEdges[2];
+
+			const float y = setup.PixelY(py);
+
+			for (int px = minX; px < maxX; ++px)
+			{
+				// the sign bit of the or is only clear when all three are >= 0
+				if ((edge0 | edge1 | edge2) >= 0)
+				{
+					const float x = setup.PixelX(px);
+					const float pixelDepth = setup.varyings[depthPlane].Evaluate(x, y);
+					float& bufferDepth = pDepthBuffer[px + py * width];
+
+					// culling
+					if (pixelDepth >= 0 && pixelDepth <= 1 && pixelDepth <= bufferDepth)
+					{
+						bufferDepth = pixelDepth;
+						depthWritten = true;
+
+						if constexpr (AttributeCount > 0)
+						{
+							const float w = 1.f / setup.varyings[inverseW].Evaluate(x, y);
+
+							float attributes[AttributeCount];
+							for (int k = 0; k < AttributeCount; ++k)
+							{
+								attributes[k] = setup.varyings[firstAttribute + k].Evaluate(x, y) * w;
+							}
+
+							if constexpr (DerivativeCount > 0)
+							{
+								float derivatives[2 * DerivativeCount];
+								setup.Differentiate(attributes, w, DerivativeCount, derivatives);
+								pixelFunction(px, py, pixelDepth, static_cast<const float*>(attributes), static_cast<const float*>(derivatives));
+							}
+							else
+							{
+								pixelFunction(px, py, pixelDepth, static_cast<const float*>(attributes), static_cast<const float*>(nullptr));
+							}
+						}
+						else
+						{
+							pixelFunction(px, py, pixelDepth, static_cast<const float*>(nullptr), static_cast<const float*>(nullptr));
+						}
+					}
+				}
+
+				edge0 += setup.edges[0].a;
+				edge1 += setup.edges[1].a;
+				edge2 += setup.edges[2].a;
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				rowEdges[i] += setup.edges[i].b;
+			}
+		}
+
+		return depthWritten;
+	}
+
+	// Same result as RasterizeScalar, but coverage, depth and interpolation run simd::Width pixels at a time.
+	// Lane x coordinates are whole numbers, stepping them by the group width is exact.
+	template<int AttributeCount, int DerivativeCount, typename PixelFunction>
+	bool RasterizeSimd(const TriangleSetup& setup, const TileRect& tile, float* pDepthBuffer, int width, PixelFunction&& pixelFunction)
+	{
+		using simd::FloatN;
+		using simd::Int64N;
+		constexpr int lanes = simd::Width;
+		constexpr int depthPlane = static_cast<int>(Varying::Depth);
+		constexpr int inverseW = static_cast<int>(Varying::InverseW);
+		constexpr int firstAttribute = static_cast<int>(Varying::FirstAttribute);
+
+		const int minX = std::max(setup.minX, tile.minX);
+		const int maxX = std::min(setup.maxX, tile.maxX);
+		const int minY = std::max(setup.minY, tile.minY);
+		const int maxY = std::min(setup.maxY, tile.maxY);
+
+		if (minX >= maxX || minY >= maxY) return false;
+
+		// groups are aligned to the tile origin so a full group never reaches into a neighbouring tile
+		const int firstGroupX = tile.minX + ((minX - tile.minX) / lanes) * lanes;
+
+		const FloatN zero{ 0.f };
+		const FloatN one{ 1.f };
+		const FloatN centreOffsetX{ setup.PixelX(0) };
+		const FloatN laneOffsets{ FloatN::LaneOffsets() };
+		const FloatN groupStep{ static_cast<float>(lanes) };
+
+		Int64N edgeStepX[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			edgeStepX[i] = Int64N{ setup.edges[i].a * lanes };
+		}
+		const PlaneEquation& depthEquation = setup.varyings[depthPlane];
+
+		int64_t rowEdges[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			rowEdges[i] = setup.edges[i].Evaluate(firstGroupX, minY);
+		}
+
+		alignas(32) float depthLanes[lanes];
+		alignas(32) float attributes[std::max(AttributeCount, 1)][lanes];
+		alignas(32) float derivatives[std::max(2 * DerivativeCount, 1)][lanes];
+
+		bool depthWritten = false;
+
+		for (int py = minY; py < maxY; ++py)
+		{
+			const FloatN yLanes{ setup.PixelY(py) };
+
+			Int64N edge0 = Int64N::Ramp(rowEdges[0], setup.edges[0].a);
+			Int64N edge1 = Int64N::Ramp(rowEdges[1], setup.edges[1].a);
+			Int64N edge2 = Int64N::Ramp(rowEdges[2], setup.edges[2].a);
+			FloatN laneX = FloatN{ static_cast<float>(firstGroupX) } + laneOffsets;
+
+			float* pDepthRow = pDepthBuffer + py * width;
+
+			for (int px = firstGroupX; px < maxX; px += lanes)
+			{
+				// there is no 64 bit compare on these lanes, but a lane is covered exactly when
+				// the sign bit of the or of its three edges is clear
+				const int inside = ~simd::SignBits(edge0 | edge1 | edge2) & simd::LaneRangeBits(px, minX, maxX);
+
+				if (inside != 0)
+				{
+					const FloatN xLanes = laneX + centreOffsetX;
+					const FloatN depth = FloatN{ depthEquation.a } * xLanes + FloatN{ depthEquation.b } * yLanes + FloatN{ depthEquation.c };
+					FloatN mask = simd::MaskFromBits(inside) & (depth >= zero) & (depth <= one); // culling
+
+					// a group hanging over the right tile border can only read and write its own lanes
+					float* pDepth = pDepthRow + px;
+					const bool fullGroup = px + lanes <= tile.maxX;
+
+					FloatN oldDepth;
+					if (fullGroup)
+					{
+						oldDepth = FloatN::Load(pDepth);
+					}
+					else
+					{
+						for (int lane = 0; lane < lanes; ++lane)
+						{
+							depthLanes[lane] = px + lane < tile.maxX ? pDepth[lane] : 0.f;
+						}
+						oldDepth = FloatN::Load(depthLanes);
+					}
+
+					mask = mask & (depth <= oldDepth);
+					const int coverage = simd::MoveMask(mask);
+
+					if (coverage != 0)
+					{
+						depthWritten = true;
+
+						const FloatN newDepth = simd::Select(mask, depth, oldDepth);
+						if (fullGroup)
+						{
+							newDepth.Store(pDepth);
+						}
+						else
+						{
+							newDepth.Store(depthLanes);
+							for (int lane = 0; lane < lanes; ++lane)
+							{
+								if (coverage & (1 << lane)) pDepth[lane] = depthLanes[lane];
+							}
+						}
+						depth.Store(depthLanes);
+
+						if constexpr (AttributeCount > 0)
+						{
+							// perspective correct interpolation of every attribute for all lanes at once
+							const PlaneEquation& wPlane = setup.varyings[inverseW];
+							const FloatN w = one / (FloatN{ wPlane.a } * xLanes + FloatN{ wPlane.b } * yLanes + FloatN{ wPlane.c });
+
+							for (int k = 0; k < AttributeCount; ++k)
+							{
+								const PlaneEquation& plane = setup.varyings[firstAttribute + k];
+								const FloatN attribute = (FloatN{ plane.a } * xLanes + FloatN{ plane.b } * yLanes + FloatN{ plane.c }) * w;
+								attribute.Store(attributes[k]);
+
+								// same as TriangleSetup::Differentiate
+								if (k < DerivativeCount)
+								{
+									((FloatN{ plane.a } - attribute * FloatN{ wPlane.a }) * w).Store(derivatives[k]);
+									((FloatN{ plane.b } - attribute * FloatN{ wPlane.b }) * w).Store(derivatives[DerivativeCount + k]);
+								}
+							}
+						}
+
+						for (int lane = 0; lane < lanes; ++lane)
+						{
+							if (!(coverage & (1 << lane))) continue;
+
+							if constexpr (AttributeCount > 0)
+							{
+								float values[AttributeCount];
+								for (int k = 0; k < AttributeCount; ++k)
+								{
+									values[k] = attributes[k][lane];
+								}
+
+								if constexpr (DerivativeCount > 0)
+								{
+									float laneDerivatives[2 * DerivativeCount];
+									for (int k = 0; k < 2 * DerivativeCount; ++k)
+									{
+										laneDerivatives[k] = derivatives[k][lane];
+									}
+									pixelFunction(px + lane, py, depthLanes[lane], static_cast<const float*>(values), static_cast<const float*>(laneDerivatives));
+								}
+								else
+								{
+									pixelFunction(px + lane, py, depthLanes[lane], static_cast<const float*>(values), static_cast<const float*>(nullptr));
+								}
+							}
+							else
+							{
+								pixelFunction(px + lane, py, depthLanes[lane], static_cast<const float*>(nullptr), static_cast<const float*>(nullptr));
+							}
+						}
+					}
+				}
+
+				edge0 += edgeStepX[0];
+				edge1 += edgeStepX[1];
+				edge2 += edgeStepX[2];
+				laneX += groupStep;
+			}
+
+			for (int i = 0; i < 3; ++i)
+			{
+				rowEdges[i] += setup.edges[i].b;
+			}
+		}
+
+		return depthWritten;
+	}
+}
@@ -7,11 +7,31 @@
 #include "Maths.h"
 #include "Texture.h"
 #include "Utils.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "RasterKernels.h"
+#include "Clipping.h"
+#include "VertexTransform.h"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 
+// prints how much the load time reordering gained on the vehicle, measuring it costs two overdraw estimates
+//#define PRINT_MESH_REPORT
 
 using namespace dae;
 
+namespace
+{
+	// the reordering MeshOptimizer::Optimize does, without measuring it
+	void ReorderMesh(Mesh& mesh)
+	{
+		MeshOptimizer::OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+		MeshOptimizer::OptimizeOverdraw(mesh.vertices, mesh.indices);
+		MeshOptimizer::OptimizeVertexFetch(mesh.vertices, mesh.indices);
+	}
+}
+
 Renderer::Renderer(SDL_Window* pWindow) :
 	m_pWindow(pWindow)
 {
@@ -28,16 +48,74 @@ Renderer::Renderer(SDL_Window* pWindow) :
 	m_AspectRatio = static_cast<float>(m_Width) / static_cast<float>(m_Height);
 	m_Camera.Initialize(m_AspectRatio, 45.f, { .0f,5.0f,64.f });
 	m_pDepthBuffer.resize(m_Height * m_Width);
+
+	m_TileCountX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_TileCountY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_TileBins.resize(m_TileCountX * m_TileCountY);
+	m_HierarchicalDepth.Resize(m_Width, m_Height);
+	m_VisibilityBuffer.resize(m_Height * m_Width);
+
+	// ndc of the guard band border, the viewport spans [-1, 1]
+	m_GuardBand =
+	{
+		1.f + 2.f * m_GuardBandPixels / static_cast<float>(m_Width),
+		1.f + 2.f * m_GuardBandPixels / static_cast<float>(m_Height)
+	};
 	m_FinalColorEnabled = true;
 
 
 	Utils::ParseOBJ("Resources/vehicle.obj", m_Vehicle.vertices, m_Vehicle.indices);
 	m_Vehicle.primitiveTopology = PrimitiveTopology::TriangleList;
+
+#ifdef PRINT_MESH_REPORT
+	const MeshOptimizer::Report report = MeshOptimizer::Optimize(m_Vehicle.vertices, m_Vehicle.indices);
+	std::cout << "vehicle ACMR: " << report.before.acmr << " -> " << report.after.acmr
+		<< ", overdraw: " << report.before.overdraw << " -> " << report.after.overdraw << std::endl;
+#else
+	ReorderMesh(m_Vehicle);
+#endif
+	m_Vehicle.ComputeBounds();
+
+	m_Vehicle.lods = MeshSimplifier::BuildLods(m_Vehicle, m_LodErrors);
+	for (Mesh& lod : m_Vehicle.lods)
+	{
+		// collapses leave the triangles in their old order
+		ReorderMesh(lod);
+		lod.meshlets = MeshOptimizer::BuildMeshlets(lod.vertices, lod.indices);
+	}
+
+	m_Vehicle.meshlets = MeshOptimizer::BuildMeshlets(m_Vehicle.vertices, m_Vehicle.indices);
 	const float Ztranslation = 110.0f;
 	const float Ytranslation = 6.f;
 
 	m_Translation = Matrix::CreateTranslation(Vector3(0, Ytranslation, Ztranslation));
 
+	// A grid of tinted vehicles behind the main one, every row twice as far as the one before it
+	// so seen from the start the rows pick the coarser levels one after the other.
+	const ColorRGB instanceTints[]{ colors::Red, colors::Green, colors::Blue, colors::Yellow, colors::Cyan, colors::Magenta, colors::White, colors::Gray };
+	constexpr int instanceColumns = 4;
+	constexpr int instanceRows = 4;
+	for (int row = 0; row < instanceRows; ++row)
+	{
+		const float rowDistance = 150.f * static_cast<float>(1 << row);
+		for (int column = 0; column < instanceColumns; ++column)
+		{
+			const int instance = row * instanceColumns + column;
+			const Vector3 position{ (column - 1.5f) * rowDistance * 0.35f, Ytranslation, Ztranslation + rowDistance };
+
+			m_InstanceWorldMatrices.push_back(Matrix::CreateRotationY(instance * 0.7f) * Matrix::CreateTranslation(position));
+			m_InstanceTints.push_back(instanceTints[instance % std::size(instanceTints)]);
+		}
+	}
+
+	m_VehicleMaterial =
+	{
+		m_TextureVehicle.get(),
+		m_NormalMapVehicle.get(),
+		m_SpecularColor.get(),
+		m_GlosinessMap.get()
+	};
+
 }
 
 Renderer::~Renderer()
@@ -58,262 +136,690 @@ void Renderer::Update(Timer* pTimer)
 		m_Vehicle.worldMatrix = m_Translation;
 	}
 
+	ClearDrawList();
+	Submit(m_Vehicle, m_Vehicle.worldMatrix, m_VehicleMaterial);
+	SubmitInstanced(m_Vehicle, m_InstanceWorldMatrices, m_VehicleMaterial, m_InstanceTints);
+}
+
+void Renderer::ClearDrawList()
+{
+	m_DrawList.clear();
+}
+
+void Renderer::Submit(const Mesh& mesh, const Matrix& worldMatrix, const Material& material)
+{
+	m_DrawList.push_back({ &mesh, worldMatrix, &material });
+}
+
+bool Renderer::SubmitInstanced(const Mesh& mesh, const std::vector<Matrix>& worldMatrices, const Material& material, const std::vector<ColorRGB>& tints)
+{
+	if (!tints.empty() && tints.size() != worldMatrices.size()) return false;
+
+	m_DrawList.reserve(m_DrawList.size() + worldMatrices.size());
+	for (size_t instance = 0; instance < worldMatrices.size(); ++instance)
+	{
+		m_DrawList.push_back({ &mesh, worldMatrices[instance], &material, tints.empty() ? colors::White : tints[instance] });
+	}
+	return true;
 }
 
 void Renderer::Render()
 {
 	SDL_LockSurface(m_pBackBuffer);
 
-	meshes_screen.clear();
-	m_Meshes.clear();
-	m_Meshes.push_back(m_Vehicle);
-	VertexTransformationFunction(m_Meshes, meshes_screen, m_Camera);
+	CullDraws();
 
-	const unsigned int backgroundColor = 100;
+	// the shader is picked once for the whole frame
+	const ShaderPermutation shader = SelectShader();
+	const TileFunction renderTile = shader.renderTile;
 
-	SDL_FillRect(m_pBackBuffer, NULL, SDL_MapRGB(m_pBackBuffer->format,
-		static_cast<uint8_t>(backgroundColor * 255),
-		static_cast<uint8_t>(backgroundColor * 255),
-		static_cast<uint8_t>(backgroundColor * 255))
-	);
+	m_Triangles.clear();
+	m_TriangleDraws.clear();
+	m_TriangleRanges.clear();
+
+	DrawBatch batch{};
+	while (NextBatch(batch))
+	{
+		VertexTransformationFunction(batch, m_Camera);
+		SetupTriangles(shader.layout, batch);
+	}
+	BinTriangles();
+
+	// tiles never share pixels, so they can clear, depth test and shade without any locking
+	m_ThreadPool.ParallelFor(m_TileCountX * m_TileCountY, [this, renderTile](int tileIndex)
+		{
+			(this->*renderTile)(tileIndex);
+		});
 
-	// depth buffer is initialized with the maximum value of float
-	std::fill(m_pDepthBuffer.begin(), m_pDepthBuffer.end(), std::numeric_limits<float>::max());
+	SDL_UnlockSurface(m_pBackBuffer);
+	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+	SDL_UpdateWindowSurface(m_pWindow);
+}
 
-	const SDL_Rect clearRect = { 0, 0, m_Width, m_Height };
-	//clearing the back buffer
-	ColorRGB finalColor = { 0,0,0 };
-	Triangle4 currentTriangle;
+void Renderer::CullDraws()
+{
+	m_VisibleDraws.clear();
+	m_VisibleSpans.clear();
+	m_VisibleVertices.clear();
+
+	// The hierarchy over the world boxes of the draws is refitted as long as the draws are the same meshes as last frame.
+	// Only a different draw list or a refit that left the tree too loose builds it again.
+	bool sameDraws = m_HierarchyMeshes.size() == m_DrawList.size();
+	m_DrawBounds.resize(m_DrawList.size());
+	for (size_t i = 0; i < m_DrawList.size(); ++i)
+	{
+		const DrawCommand& draw = m_DrawList[i];
+		m_DrawBounds[i] = draw.pMesh->boundingBox.Transformed(draw.worldMatrix);
+		sameDraws = sameDraws && m_HierarchyMeshes[i] == draw.pMesh;
+	}
 
-	for (int i = 0; i < m_Meshes[0].indices.size() - 2; i += 3)
+	if (!sameDraws || !m_DrawHierarchy.Refit(m_DrawBounds))
 	{
-		if (m_Meshes[0].primitiveTopology == PrimitiveTopology::TriangleList)
+		m_DrawHierarchy.Build(m_DrawBounds);
+
+		m_HierarchyMeshes.resize(m_DrawList.size());
+		for (size_t i = 0; i < m_DrawList.size(); ++i)
 		{
-			currentTriangle =
-			{
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 1]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 2]]
-			};
+			m_HierarchyMeshes[i] = m_DrawList[i].pMesh;
+		}
+	}
+
+	// closest first, so the nearer draws fill the depth buffer before the ones they hide
+	const Frustum& frustum = m_Camera.frustum;
+	m_DrawHierarchy.Query(frustum, m_Camera.origin, m_DrawOrder);
+
+	for (const uint32_t drawListIndex : m_DrawOrder)
+	{
+		const DrawCommand& draw = m_DrawList[drawListIndex];
+		const Mesh& mesh = *draw.pMesh;
+		const Matrix& world = draw.worldMatrix;
+
+		// the box passed already, the sphere can still be tighter for round meshes
+		const float scale = std::sqrt(std::max({ world.GetAxisX().SqrMagnitude(), world.GetAxisY().SqrMagnitude(), world.GetAxisZ().SqrMagnitude() }));
+		const BoundingSphere sphere{ world.TransformPoint(mesh.boundingSphere.centre), mesh.boundingSphere.radius * scale };
+		if (!frustum.Intersects(sphere)) continue;
 
+		// from here on the draw uses the level it needs at its distance
+		const Mesh& lod = SelectLod(mesh, sphere, scale);
+
+		const uint32_t drawIndex = static_cast<uint32_t>(m_VisibleDraws.size());
+		m_VisibleDraws.push_back(draw);
+		m_VisibleDraws.back().pMesh = &lod;
+
+		if (lod.meshlets.empty())
+		{
+			const uint32_t triangleCount = lod.indices.size() < 3 ? 0 : static_cast<uint32_t>(lod.indices.size() / 3);
+			m_VisibleSpans.push_back({ drawIndex, 0, triangleCount });
+			m_VisibleVertices.push_back({ drawIndex, 0, static_cast<uint32_t>(lod.vertices.size()) });
+			continue;
 		}
-		else if (i % 2 == 0)
+
+		CullMeshlets(lod, world, scale, drawIndex);
+	}
+}
+
+const Mesh& Renderer::SelectLod(const Mesh& mesh, const BoundingSphere& worldSphere, float scale) const
+{
+	if (mesh.lods.empty()) return mesh;
+
+	// pixels one unit of the mesh covers at the point of its bounds closest to the camera
+	const float distance = std::max((worldSphere.centre - m_Camera.origin).Magnitude() - worldSphere.radius, m_Camera.near);
+	const float pixelsPerUnit = scale * 0.5f * static_cast<float>(m_Height) / (distance * m_Camera.fov);
+
+	// the coarsest level whose error still stays below a pixel
+	const Mesh* pSelected = &mesh;
+	for (const Mesh& lod : mesh.lods)
+	{
+		if (lod.lodError * pixelsPerUnit > m_LodPixelError) break;
+		pSelected = &lod;
+	}
+	return *pSelected;
+}
+
+void Renderer::CullMeshlets(const Mesh& mesh, const Matrix& world, float scale, uint32_t drawIndex)
+{
+	const Frustum& frustum = m_Camera.frustum;
+
+	// a meshlet facing away only disappears when back faces get culled anyway
+	const bool cullBackFacing = m_CullMode == CullMode::Back;
+
+	m_MeshletVertices.clear();
+	for (const Meshlet& meshlet : mesh.meshlets)
+	{
+		const BoundingSphere sphere{ world.TransformPoint(meshlet.boundingSphere.centre), meshlet.boundingSphere.radius * scale };
+		if (!frustum.Intersects(sphere)) continue;
+
+		if (cullBackFacing && meshlet.coneCutoff < 1.f)
 		{
-			currentTriangle =
-			{
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 1]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 2]]
-			};
+			// rotations and uniform scales keep the angles, so the cone only has to be turned
+			const Vector3 axis{ world.TransformVector(meshlet.coneAxis).Normalized() };
+			const Vector3 toCentre{ sphere.centre - m_Camera.origin };
+			if (Vector3::Dot(toCentre, axis) >= meshlet.coneCutoff * toCentre.Magnitude() + sphere.radius) continue;
 		}
-		else
+
+		m_MeshletVertices.push_back({ drawIndex, meshlet.firstVertex, meshlet.firstVertex + meshlet.vertexCount });
+
+		// neighbouring meshlets are neighbours in the index buffer too, so a run of visible ones is one span
+		if (!m_VisibleSpans.empty())
 		{
-			currentTriangle =
+			DrawSpan& previous = m_VisibleSpans.back();
+			if (previous.drawIndex == drawIndex && previous.firstTriangle + previous.triangleCount == meshlet.firstTriangle)
 			{
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 2]],
-				meshes_screen[0].vertices_out[m_Meshes[0].indices[i + 1]]
-			};
+				previous.triangleCount += meshlet.triangleCount;
+				continue;
+			}
 		}
 
-		//optimization
+		m_VisibleSpans.push_back({ drawIndex, meshlet.firstTriangle, meshlet.triangleCount });
+	}
+
+	// the vertex ranges of meshlets overlap where they share vertices, merged they cover each used vertex once
+	std::sort(m_MeshletVertices.begin(), m_MeshletVertices.end(), [](const VertexRange& a, const VertexRange& b)
+		{
+			return a.first < b.first;
+		});
 
-		int minX = static_cast<int>(std::min(currentTriangle.vertex0.position.x, std::min(currentTriangle.vertex1.position.x, currentTriangle.vertex2.position.x)) - 1);
-		int maxX = static_cast<int>(std::max(currentTriangle.vertex0.position.x, std::max(currentTriangle.vertex1.position.x, currentTriangle.vertex2.position.x)) + 1);
-		int minY = static_cast<int>(std::min(currentTriangle.vertex0.position.y, std::min(currentTriangle.vertex1.position.y, currentTriangle.vertex2.position.y)) - 1);
-		int maxY = static_cast<int>(std::max(currentTriangle.vertex0.position.y, std::max(currentTriangle.vertex1.position.y, currentTriangle.vertex2.position.y)) + 1);
+	for (const VertexRange& range : m_MeshletVertices)
+	{
+		if (!m_VisibleVertices.empty() && m_VisibleVertices.back().drawIndex == drawIndex && range.first <= m_VisibleVertices.back().last)
+		{
+			m_VisibleVertices.back().last = std::max(m_VisibleVertices.back().last, range.last);
+			continue;
+		}
 
-		// if statement of std::clamp from C++ 20
-		minX = std::ranges::clamp(minX, 0, m_Width);
-		maxX = std::ranges::clamp(maxX, 0, m_Width);
-		minY = std::ranges::clamp(minY, 0, m_Height);
-		maxY = std::ranges::clamp(maxY, 0, m_Height);
+		m_VisibleVertices.push_back(range);
+	}
+}
+
+bool Renderer::NextBatch(DrawBatch& batch) const
+{
+	if (batch.lastDraw == m_VisibleDraws.size()) return false;
+
+	batch.firstDraw = batch.lastDraw;
+	size_t vertexCount = 0;
+	do
+	{
+		vertexCount += m_VisibleDraws[batch.lastDraw].pMesh->vertices.size();
+		++batch.lastDraw;
+	} while (batch.lastDraw < m_VisibleDraws.size() && vertexCount + m_VisibleDraws[batch.lastDraw].pMesh->vertices.size() <= m_BatchVertexBudget);
+
+	// culling emits spans and ranges draw after draw, so the ones of the batch follow the previous batch's
+	batch.firstSpan = batch.lastSpan;
+	while (batch.lastSpan < m_VisibleSpans.size() && m_VisibleSpans[batch.lastSpan].drawIndex < batch.lastDraw)
+	{
+		++batch.lastSpan;
+	}
 
-		for (int px = minX; px < maxX; ++px)
+	batch.firstVertexRange = batch.lastVertexRange;
+	while (batch.lastVertexRange < m_VisibleVertices.size() && m_VisibleVertices[batch.lastVertexRange].drawIndex < batch.lastDraw)
+	{
+		++batch.lastVertexRange;
+	}
+	return true;
+}
+
+void Renderer::SetupTriangles(const VaryingLayout& layout, const DrawBatch& batch)
+{
+	// the triangles of every span of the batch get their own range of slots, split into jobs that never cross a span
+	constexpr int trianglesPerJob = 1024;
+
+	m_SetupJobs.clear();
+
+	// earlier batches left their clipped pieces behind their slots, so slots and ranges start at different places
+	const int firstSlot = static_cast<int>(m_Triangles.size());
+	const int firstRange = static_cast<int>(m_TriangleRanges.size());
+
+	int triangleCount = 0;
+	for (size_t spanIndex = batch.firstSpan; spanIndex < batch.lastSpan; ++spanIndex)
+	{
+		const DrawSpan& span = m_VisibleSpans[spanIndex];
+		const int last = static_cast<int>(span.firstTriangle + span.triangleCount);
+		for (int first = static_cast<int>(span.firstTriangle); first < last; first += trianglesPerJob)
 		{
-			for (int py = minY; py < maxY; ++py)
+			const int jobLast = std::min(first + trianglesPerJob, last);
+			m_SetupJobs.push_back({ span.drawIndex, first, jobLast, firstSlot + triangleCount });
+			triangleCount += jobLast - first;
+		}
+	}
+
+	m_Triangles.resize(firstSlot + triangleCount);
+	m_TriangleDraws.resize(firstSlot + triangleCount);
+	m_TriangleRanges.resize(firstRange + triangleCount);
+
+	m_ThreadPool.ParallelFor(static_cast<int>(m_SetupJobs.size()), [&](int jobIndex)
+		{
+			const SetupJob& job = m_SetupJobs[jobIndex];
+			const Mesh4AxisVertex& mesh = meshes_screen[job.drawIndex - batch.firstDraw];
+
+			for (int meshTriangle = job.first; meshTriangle < job.last; ++meshTriangle)
 			{
-				Vertex_Out P = { {static_cast<float>(px) + 0.5f, static_cast<float>(py) + 0.5f,0,1} };
+				const int triangleIndex = job.firstSlot + meshTriangle - job.first;
 
-				Vector2 uvInterp = { 0,0 };
-				float pixelDepth = 0;
+				TriangleRange& range = m_TriangleRanges[firstRange + triangleIndex - firstSlot];
+				range = { static_cast<uint32_t>(triangleIndex), 0 };
+				m_TriangleDraws[triangleIndex] = job.drawIndex;
 
-				if (!Utils::IsPixelInterpolated(currentTriangle.vertex0, currentTriangle.vertex1, currentTriangle.vertex2, P, uvInterp, pixelDepth))
+				Triangle4 currentTriangle = AssembleTriangle(mesh, meshTriangle);
+
+				const Vector4& position0 = currentTriangle.vertex0.position;
+				const Vector4& position1 = currentTriangle.vertex1.position;
+				const Vector4& position2 = currentTriangle.vertex2.position;
+
+				// all three vertices outside the same plane of the view frustum
+				if (ComputeOutcode(position0) & ComputeOutcode(position1) & ComputeOutcode(position2)) continue;
+
+				// Only triangles crossing the near or far plane, or reaching past the guard band, have to be clipped.
+				// The few that do are clipped after all the others are set up.
+				if (ComputeOutcode(position0, m_GuardBand) | ComputeOutcode(position1, m_GuardBand) | ComputeOutcode(position2, m_GuardBand))
 				{
+					range.count = m_NeedsClipping;
 					continue;
 				}
 
-				const int pixelIndex = { px + py * m_Width };
+				ProjectToScreen(currentTriangle.vertex0.position);
+				ProjectToScreen(currentTriangle.vertex1.position);
+				ProjectToScreen(currentTriangle.vertex2.position);
 
-				if (pixelDepth > m_pDepthBuffer[pixelIndex]) continue;
+				range.count = SetupTriangle(currentTriangle, layout, m_Triangles[triangleIndex]) ? 1 : 0;
+			}
+		});
 
-				m_pDepthBuffer[pixelIndex] = pixelDepth;
+	// clipped pieces are appended behind the unclipped triangles, the range keeps them in submission order
+	ClippedPolygon polygon;
+	for (const SetupJob& job : m_SetupJobs)
+	{
+		for (int meshTriangle = job.first; meshTriangle < job.last; ++meshTriangle)
+		{
+			TriangleRange& range = m_TriangleRanges[firstRange + job.firstSlot - firstSlot + meshTriangle - job.first];
+			if (range.count != m_NeedsClipping) continue;
 
-				if (m_FinalColorEnabled)
-				{
-					finalColor = PixelShading(P, uvInterp);
-				}
-				if (!m_FinalColorEnabled)
-				{
-					const float a = Remap(pixelDepth, 0.985f,1.f, 0.f, .8f);
+			range = { static_cast<uint32_t>(m_Triangles.size()), 0 };
+
+			const Triangle4 currentTriangle = AssembleTriangle(meshes_screen[job.drawIndex - batch.firstDraw], meshTriangle);
+
+			const uint32_t planes = ComputeOutcode(currentTriangle.vertex0.position, m_GuardBand)
+				| ComputeOutcode(currentTriangle.vertex1.position, m_GuardBand)
+				| ComputeOutcode(currentTriangle.vertex2.position, m_GuardBand);
+
+			if (!ClipTriangle(currentTriangle, planes, m_GuardBand, polygon)) continue;
+
+			for (int i = 0; i < polygon.vertexCount; ++i)
+			{
+				ProjectToScreen(polygon.vertices[i].position);
+			}
 
-					finalColor = ColorRGB{ a, a, a };
+			// the clipped polygon is convex, so a fan around its first vertex covers it
+			for (int i = 1; i + 1 < polygon.vertexCount; ++i)
+			{
+				const Triangle4 piece{ polygon.vertices[0], polygon.vertices[i], polygon.vertices[i + 1] };
+
+				TriangleSetup setup;
+				if (SetupTriangle(piece, layout, setup))
+				{
+					m_Triangles.push_back(setup);
+					m_TriangleDraws.push_back(job.drawIndex);
+					++range.count;
 				}
-				//finalColor.MaxToOne();
-				m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-					static_cast<uint8_t>(finalColor.r * 255),
-					static_cast<uint8_t>(finalColor.g * 255),
-					static_cast<uint8_t>(finalColor.b * 255));
 			}
 		}
 	}
-	SDL_UnlockSurface(m_pBackBuffer);
-	SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-	SDL_UpdateWindowSurface(m_pWindow);
 }
 
-void Renderer::VertexTransformationFunction(const std::vector<Mesh>& meshes_in, std::vector<Mesh4AxisVertex>& meshes_out, const Camera camera)
+bool Renderer::SetupTriangle(const Triangle4& triangle, const VaryingLayout& layout, TriangleSetup& setup) const
 {
-	for (int i = 0; i < meshes_in.size(); i++)
-	{
-		std::vector<Vertex_Out> vertices_out;
-		Mesh4AxisVertex newMesh;
+	float attributes[3][TriangleSetup::MaxAttributeCount];
+	layout.pWriteAttributes(triangle.vertex0, attributes[0]);
+	layout.pWriteAttributes(triangle.vertex1, attributes[1]);
+	layout.pWriteAttributes(triangle.vertex2, attributes[2]);
 
-		for (const auto& vertex : meshes_in[i].vertices)
-		{
-			Vertex_Out newVertex
-			{
-				Vector4{vertex.position.x,vertex.position.y,vertex.position.z,1},
-				vertex.color,
-				vertex.uv,
-				vertex.normal,
-				vertex.tangent,
-				vertex.viewDirection
-			};
-			const Matrix worldViewProjectionMatrix{ meshes_in[i].worldMatrix * m_Camera.worldViewProectionMatrix };
-			newVertex.position = worldViewProjectionMatrix.TransformPoint(newVertex.position);
-
-			//perspective divide
-			newVertex.position.x = newVertex.position.x / newVertex.position.w;
-			newVertex.position.y = newVertex.position.y / newVertex.position.w;
-			newVertex.position.z = newVertex.position.z / newVertex.position.w;
-
-			// Convert from NDC to screen
-			newVertex.position.x = ConvertNDCtoScreen(newVertex.position, m_Width, m_Height).x;
-			newVertex.position.y = ConvertNDCtoScreen(newVertex.position, m_Width, m_Height).y;
-
-			newVertex.uv = vertex.uv;
-
-			newVertex.normal = m_Vehicle.worldMatrix.TransformVector(newVertex.normal);
-			newVertex.tangent = m_Vehicle.worldMatrix.TransformVector(newVertex.tangent);
-
-			newVertex.viewDirection = camera.origin - newVertex.position;
-			newVertex.viewDirection.Normalize();
-
-			vertices_out.push_back(newVertex);
-		}
-		newMesh =
-		{
-			vertices_out,
-			meshes_in[i].indices,
-			meshes_in[i].primitiveTopology
+	return setup.Setup(triangle, attributes, layout.attributeCount, m_Width, m_Height, m_CullMode);
+}
 
-		};
+Triangle4 Renderer::AssembleTriangle(const Mesh4AxisVertex& mesh, int triangleIndex) const
+{
+	const std::vector<Vertex_Out>& vertices = mesh.vertices_out;
+	const std::vector<uint32_t>& indices = *mesh.pIndices;
+	const size_t i = static_cast<size_t>(triangleIndex) * 3;
 
-		meshes_out.push_back(newMesh);
+	if (mesh.primitiveTopology == PrimitiveTopology::TriangleList || i % 2 == 0)
+	{
+		return
+		{
+			vertices[indices[i]],
+			vertices[indices[i + 1]],
+			vertices[indices[i + 2]]
+		};
 	}
 
+	return
+	{
+		vertices[indices[i]],
+		vertices[indices[i + 2]],
+		vertices[indices[i + 1]]
+	};
 }
-bool Renderer::SaveBufferToImage() const
+
+void Renderer::ProjectToScreen(Vector4& position) const
 {
-	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+	//perspective divide, w is kept for perspective correct interpolation
+	position.x = position.x / position.w;
+	position.y = position.y / position.w;
+	position.z = position.z / position.w;
+
+	// Convert from NDC to screen
+	const Vector2 screen = ConvertNDCtoScreen(position, m_Width, m_Height);
+	position.x = screen.x;
+	position.y = screen.y;
 }
-Vector2 Renderer::ConvertNDCtoScreen(const Vector3& ndc, int screenWidth, int screenHeight)const
+
+void Renderer::BinTriangles()
 {
-	float screenSpaceX = (ndc.x + 1.0f) / 2.0f * screenWidth;
-	float screenSpaceY = (1.0f - ndc.y) / 2.0f * screenHeight;
-	return Vector2{ screenSpaceX, screenSpaceY };
+	for (std::vector<uint32_t>& bin : m_TileBins)
+	{
+		bin.clear();
+	}
+
+	// triangles are appended in submission order so every tile resolves depth ties like the unbinned loop did
+	for (const TriangleRange& range : m_TriangleRanges)
+	{
+		for (uint32_t triangleIndex = range.first; triangleIndex < range.first + range.count; ++triangleIndex)
+		{
+			const TriangleSetup& setup = m_Triangles[triangleIndex];
+
+			const int firstTileX = setup.minX / m_TileSize;
+			const int lastTileX = (setup.maxX - 1) / m_TileSize;
+			const int firstTileY = setup.minY / m_TileSize;
+			const int lastTileY = (setup.maxY - 1) / m_TileSize;
+
+			for (int tileY = firstTileY; tileY <= lastTileY; ++tileY)
+			{
+				for (int tileX = firstTileX; tileX <= lastTileX; ++tileX)
+				{
+					m_TileBins[tileX + tileY * m_TileCountX].push_back(triangleIndex);
+				}
+			}
+		}
+	}
 }
-ColorRGB Renderer::PixelShading(Vertex_Out& v, const Vector2& uvInterpolated)
+
+template<ShaderProgram Program>
+void Renderer::RenderTile(int tileIndex)
 {
-	const Vector3 lightDirection = { 0.577f, -.577f, -.577f };
-	const float lightIntensivity = 2.f;
+	constexpr int attributeCount = AttributeCount<typename Program::Varyings>;
+	constexpr int derivativeCount = DerivativeCount<Program>;
+	const Program program{};
+
+	const int minX = (tileIndex % m_TileCountX) * m_TileSize;
+	const int minY = (tileIndex / m_TileCountX) * m_TileSize;
+	const int maxX = std::min(minX + m_TileSize, m_Width);
+	const int maxY = std::min(minY + m_TileSize, m_Height);
 
-	const int shiniessValue = 25;
+	const unsigned int backgroundColor = 100;
+	const uint32_t clearColor = SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(backgroundColor * 255),
+		static_cast<uint8_t>(backgroundColor * 255),
+		static_cast<uint8_t>(backgroundColor * 255));
+
+	for (int py = minY; py < maxY; ++py)
+	{
+		const int rowStart = py * m_Width;
 
-	//normal mapping
-	Vector3 binormal = Vector3::Cross(v.normal, v.tangent);
-	Matrix tangentSpaceAxis = Matrix{ v.tangent, binormal, v.normal, {0,0,0} };
-	ColorRGB sampledNormal = m_NormalMapVehicle->Sample(uvInterpolated);
+		std::fill(m_pBackBufferPixels + rowStart + minX, m_pBackBufferPixels + rowStart + maxX, clearColor);
 
-	sampledNormal = 2 * sampledNormal - ColorRGB{ 1,1,1 };
+		// depth buffer is initialized with the maximum value of float
+		std::fill(m_pDepthBuffer.begin() + rowStart + minX, m_pDepthBuffer.begin() + rowStart + maxX, std::numeric_limits<float>::max());
+	}
 
-	const Vector3 resultNormal = tangentSpaceAxis.TransformVector(sampledNormal.r, sampledNormal.g, sampledNormal.b);
+	const TileRect tile{ minX, maxX, minY, maxY };
+	m_HierarchicalDepth.Clear(tile, std::numeric_limits<float>::max());
 
-	if (m_NormalMapEnabled)
+	if (m_ShadingMode == ShadingMode::Deferred)
 	{
-		v.normal = resultNormal;
+		for (int py = minY; py < maxY; ++py)
+		{
+			const int rowStart = py * m_Width;
+			std::fill(m_VisibilityBuffer.begin() + rowStart + minX, m_VisibilityBuffer.begin() + rowStart + maxX, m_NoTriangle);
+		}
 	}
 
-	// lambert diffuse
-	const auto& sampledColor = m_TextureVehicle->Sample(uvInterpolated);
-	const ColorRGB diffuseColor = lightIntensivity * sampledColor;
 
-	ColorRGB lambertFinalColor = diffuseColor / float(M_PI);
+	constexpr int blockSize = HierarchicalDepth::BlockSize;
+
+	for (const uint32_t triangleIndex : m_TileBins[tileIndex])
+	{
+		const TriangleSetup& setup = m_Triangles[triangleIndex];
 
-	float cosAngle = Vector3::Dot(v.normal, lightDirection);
+		// whole triangle is behind everything already drawn in this tile
+		if (setup.minDepth > m_HierarchicalDepth.GetMaxDepth(tile)) continue;
 
+		const int firstBlockX = std::max(setup.minX, minX) / blockSize;
+		const int lastBlockX = (std::min(setup.maxX, maxX) - 1) / blockSize;
+		const int firstBlockY = std::max(setup.minY, minY) / blockSize;
+		const int lastBlockY = (std::min(setup.maxY, maxY) - 1) / blockSize;
 
-	// phong 
-	const Vector3 reflect = Vector3::Reflect(lightDirection, v.normal);
-	const float cosAlpha = std::max(Vector3::Dot(reflect, v.viewDirection), 0.0f);
+		for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY)
+		{
+			for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX)
+			{
+				const TileRect block
+				{
+					std::max(blockX * blockSize, setup.minX),
+					std::min((blockX + 1) * blockSize, std::min(setup.maxX, maxX)),
+					std::max(blockY * blockSize, setup.minY),
+					std::min((blockY + 1) * blockSize, std::min(setup.maxY, maxY))
+				};
+
+				if (!setup.MayCover(block)) continue;
+				if (setup.minDepth > m_HierarchicalDepth.GetBlockMaxDepth(blockX, blockY, m_pDepthBuffer.data())) continue;
+
+				// the kernels align their lane groups to the rect they get, so hand them the full block
+				const TileRect kernelRect
+				{
+					blockX * blockSize,
+					std::min((blockX + 1) * blockSize, maxX),
+					blockY * blockSize,
+					std::min((blockY + 1) * blockSize, maxY)
+				};
+
+				bool depthWritten{};
+				if (m_ShadingMode == ShadingMode::Deferred)
+				{
+					// only remember who won the depth test, shading waits until the tile is done
+					depthWritten = RasterizeBlock<0, 0>(setup, kernelRect, [this, triangleIndex](int px, int py, float, const float*, const float*)
+						{
+							m_VisibilityBuffer[px + py * m_Width] = triangleIndex;
+						});
+				}
+				else
+				{
+					const DrawCommand& draw = m_VisibleDraws[m_TriangleDraws[triangleIndex]];
+					depthWritten = RasterizeBlock<attributeCount, derivativeCount>(setup, kernelRect,
+						[this, &program, &draw](int px, int py, float pixelDepth, const float* pAttributes, const float* pDerivatives)
+						{
+							ShadePixel(program, draw, px, py, pixelDepth, pAttributes, pDerivatives);
+						});
+				}
 
-	const ColorRGB specularity = m_SpecularColor->Sample(uvInterpolated);
-	float glosiness = m_GlosinessMap->Sample(uvInterpolated).r;
+				if (depthWritten)
+				{
+					m_HierarchicalDepth.MarkDirty(blockX, blockY);
+				}
+			}
+		}
+	}
 
-	const ColorRGB specularColor = specularity * powf(cosAlpha, glosiness * shiniessValue) * colors::White;
-	const ColorRGB ambientOcclusion = { 0.05f, 0.05f,0.05f };
+	if (m_ShadingMode == ShadingMode::Deferred)
+	{
+		ShadeVisibleTriangles(program, tile);
+	}
+}
 
-	switch (m_CurrentLightingMode)
+template<int AttributeCount, int DerivativeCount, typename PixelFunction>
+bool Renderer::RasterizeBlock(const TriangleSetup& setup, const TileRect& rect, PixelFunction&& pixelFunction)
+{
+	if (m_RasterPath == RasterPath::Simd)
 	{
-	case LightingMode::ObservedArea:
+		return RasterizeSimd<AttributeCount, DerivativeCount>(setup, rect, m_pDepthBuffer.data(), m_Width, pixelFunction);
+	}
 
-		if (cosAngle < 0) return { 0,0,0 };
-		return ColorRGB{ cosAngle, cosAngle,cosAngle };
+	return RasterizeScalar<AttributeCount, DerivativeCount>(setup, rect, m_pDepthBuffer.data(), m_Width, pixelFunction);
+}
 
-		break;
+template<ShaderProgram Program>
+void Renderer::ShadeVisibleTriangles(const Program& program, const TileRect& tile)
+{
+	constexpr int derivativeCount = DerivativeCount<Program>;
 
-	case LightingMode::Diffuse:
+	float attributes[TriangleSetup::MaxAttributeCount];
+	float derivatives[2 * TriangleSetup::MaxAttributeCount];
 
-		if (cosAngle < 0) return { 0,0,0 };
+	// every pixel is shaded once, no matter how many triangles were drawn on top of each other
+	for (int py = tile.minY; py < tile.maxY; ++py)
+	{
+		for (int px = tile.minX; px < tile.maxX; ++px)
+		{
+			const int pixelIndex = px + py * m_Width;
+			const uint32_t triangleIndex = m_VisibilityBuffer[pixelIndex];
+			if (triangleIndex == m_NoTriangle) continue;
 
-		return lambertFinalColor * ColorRGB{ cosAngle, cosAngle, cosAngle };
+			const TriangleSetup& setup = m_Triangles[triangleIndex];
+			const float w = setup.EvaluateAttributes(px, py, attributes);
+			setup.Differentiate(attributes, w, derivativeCount, derivatives);
 
-		break;
+			ShadePixel(program, m_VisibleDraws[m_TriangleDraws[triangleIndex]], px, py, m_pDepthBuffer[pixelIndex], attributes, derivatives);
+		}
+	}
+}
 
-	case LightingMode::Specular:
+template<ShaderProgram Program>
+void Renderer::ShadePixel(const Program& program, const DrawCommand& draw, int px, int py, float pixelDepth, const float* pAttributes, const float* pDerivatives)
+{
+	const ColorRGB finalColor = program.Pixel(ReadAttributes<Program>(pAttributes), ReadDerivatives<Program>(pDerivatives), draw, pixelDepth);
 
-		if (cosAngle < 0)return { 0,0,0 };
-		return specularColor * ColorRGB{ cosAngle, cosAngle, cosAngle };
+	//finalColor.MaxToOne();
+	m_pBackBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255),
+		static_cast<uint8_t>(finalColor.g * 255),
+		static_cast<uint8_t>(finalColor.b * 255));
+}
 
-		break;
+void Renderer::VertexTransformationFunction(const DrawBatch& batch, const Camera& camera)
+{
+	constexpr int verticesPerJob = 4096;
 
-	case LightingMode::Combined:
+	// Outputs are sized up front, so every job writes its own range and nobody has to push_back.
+	// Draw i of the batch writes to slot i, the slots live on between batches and frames and only ever grow.
+	const size_t drawCount = batch.lastDraw - batch.firstDraw;
+	if (meshes_screen.size() < drawCount)
+	{
+		meshes_screen.resize(drawCount);
+	}
 
-		if (cosAngle < 0)return { 0,0,0 };
+	m_DrawTransforms.resize(drawCount);
+	m_VertexJobs.clear();
 
-		return (lambertFinalColor + specularColor + ambientOcclusion) * ColorRGB(cosAngle, cosAngle, cosAngle);
+	for (size_t i = 0; i < drawCount; i++)
+	{
+		const DrawCommand& draw = m_VisibleDraws[batch.firstDraw + i];
+		const Mesh& mesh = *draw.pMesh;
+		const int vertexCount = static_cast<int>(mesh.vertices.size());
 
-		break;
+		// position stays in clip space, the perspective divide happens after clipping
+		m_DrawTransforms[i] =
+		{
+			draw.worldMatrix * camera.worldViewProectionMatrix,
+			draw.worldMatrix,
+			camera.origin,
+			static_cast<float>(m_Width),
+			static_cast<float>(m_Height)
+		};
+
+		Mesh4AxisVertex& newMesh = meshes_screen[i];
+		newMesh.vertices_out.resize(vertexCount);
+		newMesh.pIndices = &mesh.indices;
+		newMesh.primitiveTopology = mesh.primitiveTopology;
+	}
+
+	// only the vertices visible spans use, the slots of the rest keep whatever they had
+	for (size_t rangeIndex = batch.firstVertexRange; rangeIndex < batch.lastVertexRange; ++rangeIndex)
+	{
+		const VertexRange& range = m_VisibleVertices[rangeIndex];
+		const uint32_t slot = static_cast<uint32_t>(range.drawIndex - batch.firstDraw);
+		const int last = static_cast<int>(range.last);
+		for (int first = static_cast<int>(range.first); first < last; first += verticesPerJob)
+		{
+			m_VertexJobs.push_back({ slot, first, std::min(first + verticesPerJob, last) });
+		}
 	}
-	return { 0,0,0 };
+
+	m_ThreadPool.ParallelFor(static_cast<int>(m_VertexJobs.size()), [&](int jobIndex)
+		{
+			const DrawJob& job = m_VertexJobs[jobIndex];
+			const Mesh& mesh = *m_VisibleDraws[batch.firstDraw + job.drawIndex].pMesh;
+
+			TransformVertices(m_DrawTransforms[job.drawIndex], mesh.vertices.data() + job.first,
+				meshes_screen[job.drawIndex].vertices_out.data() + job.first, job.last - job.first);
+		});
+}
+bool Renderer::SaveBufferToImage() const
+{
+	return SDL_SaveBMP(m_pBackBuffer, "Rasterizer_ColorBuffer.bmp");
+}
+Vector2 Renderer::ConvertNDCtoScreen(const Vector3& ndc, int screenWidth, int screenHeight)const
+{
+	float screenSpaceX = (ndc.x + 1.0f) / 2.0f * screenWidth;
+	float screenSpaceY = (1.0f - ndc.y) / 2.0f * screenHeight;
+	return Vector2{ screenSpaceX, screenSpaceY };
+}
+Renderer::ShaderPermutation Renderer::SelectShader() const
+{
+	// one copy of the tile loop per shader program, each with its own varyings and pixel function inlined
+	static constexpr ShaderPermutation lightingShaders[4][2]
+	{
+		{
+			{ MakeVaryingLayout<LightingShader<LightingMode::ObservedArea, false>>(), &Renderer::RenderTile<LightingShader<LightingMode::ObservedArea, false>> },
+			{ MakeVaryingLayout<LightingShader<LightingMode::ObservedArea, true>>(), &Renderer::RenderTile<LightingShader<LightingMode::ObservedArea, true>> }
+		},
+		{
+			{ MakeVaryingLayout<LightingShader<LightingMode::Diffuse, false>>(), &Renderer::RenderTile<LightingShader<LightingMode::Diffuse, false>> },
+			{ MakeVaryingLayout<LightingShader<LightingMode::Diffuse, true>>(), &Renderer::RenderTile<LightingShader<LightingMode::Diffuse, true>> }
+		},
+		{
+			{ MakeVaryingLayout<LightingShader<LightingMode::Specular, false>>(), &Renderer::RenderTile<LightingShader<LightingMode::Specular, false>> },
+			{ MakeVaryingLayout<LightingShader<LightingMode::Specular, true>>(), &Renderer::RenderTile<LightingShader<LightingMode::Specular, true>> }
+		},
+		{
+			{ MakeVaryingLayout<LightingShader<LightingMode::Combined, false>>(), &Renderer::RenderTile<LightingShader<LightingMode::Combined, false>> },
+			{ MakeVaryingLayout<LightingShader<LightingMode::Combined, true>>(), &Renderer::RenderTile<LightingShader<LightingMode::Combined, true>> }
+		}
+	};
+	static constexpr ShaderPermutation depthShader{ MakeVaryingLayout<DepthShader>(), &Renderer::RenderTile<DepthShader> };
+
+	if (!m_FinalColorEnabled) return depthShader;
+
+	return lightingShaders[static_cast<int>(m_CurrentLightingMode)][m_NormalMapEnabled ? 1 : 0];
 }
+
 void Renderer::CycleLightingMode()
 {
 	int currentLightingMode = static_cast<int>(m_CurrentLightingMode);
 	++currentLightingMode %= 4;
 	m_CurrentLightingMode = LightingMode{ currentLightingMode };
 }
+void Renderer::ToggleRasterPath()
+{
+	m_RasterPath = m_RasterPath == RasterPath::Simd ? RasterPath::Scalar : RasterPath::Simd;
+}
+void Renderer::CycleCullMode()
+{
+	int currentCullMode = static_cast<int>(m_CullMode);
+	++currentCullMode %= 3;
+	m_CullMode = CullMode{ currentCullMode };
+}
+void Renderer::ToggleDeferredShading()
+{
+	m_ShadingMode = m_ShadingMode == ShadingMode::Deferred ? ShadingMode::Forward : ShadingMode::Deferred;
+}
 void Renderer::RotateModel()
 {
 	m_CanBeRotated = !m_CanBeRotated;
@@ -3,9 +3,17 @@
 #include <cstdint>
 #include <vector>
 #include <memory>
+#include "BoundingVolumeHierarchy.h"
 #include "Camera.h"
+#include "Clipping.h"
 #include "DataTypes.h"
+#include "HierarchicalDepth.h"
+#include "LightingShader.h"
 #include "Texture.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include "TriangleSetup.h"
+#include "VertexTransform.h"
 
 
 struct SDL_Window;
@@ -36,14 +44,66 @@ namespace dae
 		void Render();
 
 		bool SaveBufferToImage() const;
-		void VertexTransformationFunction(const std::vector<Mesh>& meshes_in, std::vector<Mesh4AxisVertex>& meshes_out,const Camera camera);
+		// Draw list, everything submitted is drawn by every Render until the list is cleared.
+		// Mesh and material are only referenced, so they have to stay alive and in place until then.
+		void ClearDrawList();
+		void Submit(const Mesh& mesh, const Matrix& worldMatrix, const Material& material);
+		// One draw of the mesh per world matrix. Tints are optional and otherwise need one entry per matrix,
+		// with any other count nothing is submitted and false is returned.
+		bool SubmitInstanced(const Mesh& mesh, const std::vector<Matrix>& worldMatrices, const Material& material, const std::vector<ColorRGB>& tints = {});
+
 		Vector2 ConvertNDCtoScreen(const Vector3& ndc, int screenWidth, int screenHeight)const;
 		void ToggleZBuffer() { m_FinalColorEnabled = !m_FinalColorEnabled; };
 		void ToggleNormalMap() { m_NormalMapEnabled = !m_NormalMapEnabled; };
-		ColorRGB PixelShading(Vertex_Out& v, const Vector2& uvInterpolated);
 		void CycleLightingMode();
 		void RotateModel();
+		void ToggleRasterPath();
+		void ToggleDeferredShading();
+		void CycleCullMode();
 	private:
+		// Visible draws [firstDraw, lastDraw) with their spans and vertex ranges, transformed and set up together.
+		// Only one batch of transformed vertices exists at a time, however many instances are drawn.
+		struct DrawBatch
+		{
+			size_t firstDraw;
+			size_t lastDraw;
+			size_t firstSpan;
+			size_t lastSpan;
+			size_t firstVertexRange;
+			size_t lastVertexRange;
+		};
+
+		void CullDraws();
+		// moves on to the draws after batch, false once all visible draws were batched
+		bool NextBatch(DrawBatch& batch) const;
+		void VertexTransformationFunction(const DrawBatch& batch, const Camera& camera);
+		void CullMeshlets(const Mesh& mesh, const Matrix& world, float scale, uint32_t drawIndex);
+		const Mesh& SelectLod(const Mesh& mesh, const BoundingSphere& worldSphere, float scale) const;
+		// the shader's vertex part runs on the triangle corners here, after clipping,
+		// the setups are appended behind the ones of earlier batches
+		void SetupTriangles(const VaryingLayout& layout, const DrawBatch& batch);
+		bool SetupTriangle(const Triangle4& triangle, const VaryingLayout& layout, TriangleSetup& setup) const;
+		Triangle4 AssembleTriangle(const Mesh4AxisVertex& mesh, int triangleIndex) const;
+		void ProjectToScreen(Vector4& position) const;
+		void BinTriangles();
+		// Every shader program has its own instantiation of the tile loop down to the pixel,
+		// so only its varyings are interpolated and no pixel has to ask which shader is on.
+		template<ShaderProgram Program>
+		void RenderTile(int tileIndex);
+		using TileFunction = void (Renderer::*)(int);
+		struct ShaderPermutation
+		{
+			VaryingLayout layout;
+			TileFunction renderTile;
+		};
+		ShaderPermutation SelectShader() const;
+		template<int AttributeCount, int DerivativeCount, typename PixelFunction>
+		bool RasterizeBlock(const TriangleSetup& setup, const TileRect& rect, PixelFunction&& pixelFunction);
+		template<ShaderProgram Program>
+		void ShadeVisibleTriangles(const Program& program, const TileRect& tile);
+		template<ShaderProgram Program>
+		void ShadePixel(const Program& program, const DrawCommand& draw, int px, int py, float pixelDepth, const float* pAttributes, const float* pDerivatives);
+
 		SDL_Window* m_pWindow{};
 
 		SDL_Surface* m_pFrontBuffer{ nullptr };
@@ -58,13 +118,54 @@ namespace dae
 		bool m_CanBeRotated = false;
 		bool m_NormalMapEnabled = false;
 
-		std::vector<Mesh> m_Meshes;
+		std::vector<DrawCommand> m_DrawList;
+		// the part of m_DrawList inside the view frustum closest first, everything after culling indexes into this one
+		std::vector<DrawCommand> m_VisibleDraws;
+
+		BoundingVolumeHierarchy m_DrawHierarchy;
+		// world boxes of m_DrawList, and the meshes the hierarchy was built for
+		std::vector<BoundingBox> m_DrawBounds;
+		std::vector<const Mesh*> m_HierarchyMeshes;
+		std::vector<uint32_t> m_DrawOrder;
+
+		// triangles of a visible draw that survived culling, a draw without meshlets is a single span
+		struct DrawSpan
+		{
+			uint32_t drawIndex;
+			uint32_t firstTriangle;
+			uint32_t triangleCount;
+		};
+
+		// vertices [first, last) of a visible draw that its spans use
+		struct VertexRange
+		{
+			uint32_t drawIndex;
+			uint32_t first;
+			uint32_t last;
+		};
+
+		std::vector<DrawSpan> m_VisibleSpans;
+		// sorted and merged per draw, meshlets share vertices but every vertex is only transformed once
+		std::vector<VertexRange> m_VisibleVertices;
+		// the ranges of the visible meshlets of one draw, before merging
+		std::vector<VertexRange> m_MeshletVertices;
+		// transformed vertices of the draws of one batch, reused by every batch and every frame
 		std::vector<Mesh4AxisVertex> meshes_screen;
+		// a batch takes draws until their meshes have this many vertices, a bigger mesh is a batch of its own
+		static constexpr size_t m_BatchVertexBudget{ 1 << 16 };
 
 		Mesh m_Vehicle{};
+		// tinted copies of the vehicle further back, submitted as one instanced call
+		std::vector<Matrix> m_InstanceWorldMatrices;
+		std::vector<ColorRGB> m_InstanceTints;
+		// simplification error of every level of detail, relative to the mesh size
+		const std::vector<float> m_LodErrors{ 0.005f, 0.015f, 0.04f };
+		// a level is used while its error projects to fewer pixels than this
+		const float m_LodPixelError{ 1.f };
+		Material m_VehicleMaterial{};
 
 		std::unique_ptr<dae::Texture> m_TextureVehicle = std::unique_ptr<dae::Texture>(dae::Texture::LoadFromFile("Resources/vehicle_diffuse.png")); 
-		std::unique_ptr<dae::Texture> m_NormalMapVehicle = std::unique_ptr<dae::Texture>(dae::Texture::LoadFromFile("Resources/vehicle_normal.png"));
+		std::unique_ptr<dae::Texture> m_NormalMapVehicle = std::unique_ptr<dae::Texture>(dae::Texture::LoadFromFile("Resources/vehicle_normal.png", dae::TextureFormat::NormalMap));
 		std::unique_ptr<dae::Texture> m_SpecularColor = std::unique_ptr<dae::Texture>(dae::Texture::LoadFromFile("Resources/vehicle_specular.png"));
 		std::unique_ptr<dae::Texture> m_GlosinessMap = std::unique_ptr<dae::Texture>(dae::Texture::LoadFromFile("Resources/vehicle_gloss.png")); 
 
@@ -72,16 +173,84 @@ namespace dae
 		int m_Height{};
 
 		std::vector<float> m_pDepthBuffer;
-	
-		enum class LightingMode
+		HierarchicalDepth m_HierarchicalDepth;
+
+		// screen is split in square tiles, each bin lists the triangles touching that tile,
+		// the size has to stay a multiple of HierarchicalDepth::BlockSize
+		const int m_TileSize{ 32 };
+		int m_TileCountX{};
+		int m_TileCountY{};
+		std::vector<TriangleSetup> m_Triangles;
+		// m_VisibleDraws entry every setup in m_Triangles belongs to
+		std::vector<uint32_t> m_TriangleDraws;
+
+		// Vertices and triangles of all draws of a batch are processed in one parallel pass each,
+		// split into jobs over [first, last) of a single draw. Vertex jobs and m_DrawTransforms
+		// name the draw by its slot in the batch, setup jobs by its index in m_VisibleDraws.
+		struct DrawJob
 		{
-			ObservedArea,
-			Diffuse,
-			Specular,
-			Combined
+			uint32_t drawIndex;
+			int first;
+			int last;
 		};
 
+		std::vector<DrawJob> m_VertexJobs;
+		std::vector<VertexTransform> m_DrawTransforms;
+
+		// triangles [first, last) of a draw are set up into the slots from firstSlot on
+		struct SetupJob
+		{
+			uint32_t drawIndex;
+			int first;
+			int last;
+			int firstSlot;
+		};
+
+		std::vector<SetupJob> m_SetupJobs;
+
+		// setups in m_Triangles that came out of one mesh triangle, more than one when it got clipped
+		struct TriangleRange
+		{
+			uint32_t first;
+			uint32_t count;
+		};
+
+		static constexpr uint32_t m_NeedsClipping{ UINT32_MAX };
+		std::vector<TriangleRange> m_TriangleRanges;
+
+		// triangles may reach this many pixels past every screen border before they get clipped,
+		// well inside the range the fixed point setup can snap
+		static constexpr float m_GuardBandPixels{ 8192.f };
+		GuardBand m_GuardBand{};
+		std::vector<std::vector<uint32_t>> m_TileBins;
+
+		ThreadPool m_ThreadPool{};
+
 		LightingMode m_CurrentLightingMode = { LightingMode::ObservedArea };
+
+		CullMode m_CullMode = { CullMode::Back };
+
+		// both paths evaluate every plane directly per pixel in the same order and produce the same image,
+		// the scalar one is kept to compare against
+		enum class RasterPath
+		{
+			Scalar,
+			Simd
+		};
+
+		RasterPath m_RasterPath = { RasterPath::Simd };
+
+		// deferred fills depth and the visibility buffer first and shades every visible pixel once afterwards
+		enum class ShadingMode
+		{
+			Forward,
+			Deferred
+		};
+
+		ShadingMode m_ShadingMode = { ShadingMode::Forward };
+
+		static constexpr uint32_t m_NoTriangle{ UINT32_MAX };
+		std::vector<uint32_t> m_VisibilityBuffer;
 		
 		Matrix m_Translation;
 	
@@ -0,0 +1,115 @@
+#pragma once
+#include <concepts>
+#include <cstring>
+#include <type_traits>
+#include "DataTypes.h"
+#include "TriangleSetup.h"
+
+namespace dae
+{
+	// screen space derivatives of the first Count attributes, ddx along the row and ddy down the column
+	template<int Count>
+	struct AttributeDerivatives
+	{
+		float ddx[Count];
+		float ddy[Count];
+	};
+
+	template<>
+	struct AttributeDerivatives<0>
+	{
+	};
+
+	// how many leading attributes a program wants derivatives of, none unless it declares DerivativeCount
+	template<typename Program>
+	constexpr int GetDerivativeCount()
+	{
+		if constexpr (requires { Program::DerivativeCount; }) return Program::DerivativeCount;
+		else return 0;
+	}
+
+	template<typename Program>
+	constexpr int DerivativeCount = GetDerivativeCount<Program>();
+
+	// A shader program declares what it needs interpolated and how it turns that into a colour:
+	//  - Varyings, a struct of plain floats, these are the only attributes set up and stepped across a triangle
+	//  - static Varyings Vertex(const Vertex_Out& vertex), picks the varyings out of a transformed triangle corner
+	//  - optionally static constexpr int DerivativeCount, the leading attributes it needs screen space derivatives of
+	//  - ColorRGB Pixel(const Varyings& in, const AttributeDerivatives<DerivativeCount>& derivatives, const DrawCommand& draw, float depth) const,
+	//    in is perspective correct and so are the derivatives, they are exact per pixel rather than taken from a quad
+	// The tile loop and the raster kernels are instantiated per program, so Pixel gets inlined into them.
+	template<typename Program>
+	concept ShaderProgram = std::is_trivially_copyable_v<typename Program::Varyings>
+		&& requires(const Program program, const Vertex_Out& vertex, const typename Program::Varyings& in,
+			const AttributeDerivatives<DerivativeCount<Program>>& derivatives, const DrawCommand& draw, float depth)
+	{
+		{ Program::Vertex(vertex) } -> std::same_as<typename Program::Varyings>;
+		{ program.Pixel(in, derivatives, draw, depth) } -> std::same_as<ColorRGB>;
+	};
+
+	// floats in a varyings struct, an empty one has none
+	template<typename Varyings>
+	constexpr int AttributeCount = std::is_empty_v<Varyings> ? 0 : static_cast<int>(sizeof(Varyings) / sizeof(float));
+
+	template<typename Varyings>
+	constexpr bool IsValidVaryings()
+	{
+		if constexpr (std::is_empty_v<Varyings>) return true;
+		else return sizeof(Varyings) % sizeof(float) == 0 && alignof(Varyings) == alignof(float)
+			&& AttributeCount<Varyings> <= TriangleSetup::MaxAttributeCount;
+	}
+
+	// runs the vertex part of a program and flattens its varyings into attributes
+	template<ShaderProgram Program>
+	void WriteAttributes(const Vertex_Out& vertex, float* pAttributes)
+	{
+		using Varyings = typename Program::Varyings;
+		static_assert(IsValidVaryings<Varyings>(), "varyings have to be plain floats and fit in TriangleSetup::MaxAttributeCount");
+		static_assert(DerivativeCount<Program> >= 0 && DerivativeCount<Program> <= AttributeCount<Varyings>, "derivatives are only taken of attributes");
+
+		if constexpr (AttributeCount<Varyings> > 0)
+		{
+			const Varyings varyings = Program::Vertex(vertex);
+			std::memcpy(pAttributes, &varyings, sizeof(Varyings));
+		}
+	}
+
+	// the other way around, interpolated attributes back into the struct the pixel part takes
+	template<ShaderProgram Program>
+	typename Program::Varyings ReadAttributes(const float* pAttributes)
+	{
+		using Varyings = typename Program::Varyings;
+
+		Varyings varyings{};
+		if constexpr (AttributeCount<Varyings> > 0)
+		{
+			std::memcpy(static_cast<void*>(&varyings), pAttributes, sizeof(Varyings));
+		}
+		return varyings;
+	}
+
+	// derivatives as the kernels write them, all ddx followed by all ddy
+	template<ShaderProgram Program>
+	AttributeDerivatives<DerivativeCount<Program>> ReadDerivatives(const float* pDerivatives)
+	{
+		AttributeDerivatives<DerivativeCount<Program>> derivatives{};
+		if constexpr (DerivativeCount<Program> > 0)
+		{
+			std::memcpy(&derivatives, pDerivatives, sizeof(derivatives));
+		}
+		return derivatives;
+	}
+
+	// what triangle setup needs to know about a program, without being a template itself
+	struct VaryingLayout
+	{
+		int attributeCount{};
+		void (*pWriteAttributes)(const Vertex_Out& vertex, float* pAttributes){};
+	};
+
+	template<ShaderProgram Program>
+	constexpr VaryingLayout MakeVaryingLayout()
+	{
+		return { AttributeCount<typename Program::Varyings>, &WriteAttributes<Program> };
+	}
+}
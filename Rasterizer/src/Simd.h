@@ -0,0 +1,181 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <immintrin.h>
+
+// Thin wrapper around the widest register the build targets.
+// AVX2 builds process 8 lanes, everything else falls back to the 4 SSE lanes every x64 cpu has.
+namespace dae::simd
+{
+#if defined(__AVX2__)
+	constexpr int Width{ 8 };
+
+	struct FloatN
+	{
+		__m256 v;
+
+		FloatN() = default;
+		FloatN(__m256 _v) : v(_v) {}
+		explicit FloatN(float f) : v(_mm256_set1_ps(f)) {}
+
+		static FloatN Load(const float* p) { return _mm256_loadu_ps(p); }
+		void Store(float* p) const { _mm256_storeu_ps(p, v); }
+
+		// p[0], p[stride], p[2 * stride], ... turns one component of an array of structs into a register
+		static FloatN Gather(const float* p, int stride)
+		{
+			const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride));
+			return _mm256_i32gather_ps(p, offsets, sizeof(float));
+		}
+
+		// 0, 1, 2, ... Width - 1
+		static FloatN LaneOffsets() { return _mm256_setr_ps(0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f); }
+
+		FloatN operator+(const FloatN& o) const { return _mm256_add_ps(v, o.v); }
+		FloatN operator-(const FloatN& o) const { return _mm256_sub_ps(v, o.v); }
+		FloatN operator*(const FloatN& o) const { return _mm256_mul_ps(v, o.v); }
+		FloatN operator/(const FloatN& o) const { return _mm256_div_ps(v, o.v); }
+		FloatN& operator+=(const FloatN& o) { v = _mm256_add_ps(v, o.v); return *this; }
+		FloatN Sqrt() const { return _mm256_sqrt_ps(v); }
+
+		// comparisons return a mask with all bits set in the lanes where they hold
+		FloatN operator>(const FloatN& o) const { return _mm256_cmp_ps(v, o.v, _CMP_GT_OQ); }
+		FloatN operator>=(const FloatN& o) const { return _mm256_cmp_ps(v, o.v, _CMP_GE_OQ); }
+		FloatN operator<(const FloatN& o) const { return _mm256_cmp_ps(v, o.v, _CMP_LT_OQ); }
+		FloatN operator<=(const FloatN& o) const { return _mm256_cmp_ps(v, o.v, _CMP_LE_OQ); }
+		FloatN operator&(const FloatN& o) const { return _mm256_and_ps(v, o.v); }
+		FloatN operator|(const FloatN& o) const { return _mm256_or_ps(v, o.v); }
+	};
+
+	// picks a where the mask is set and b everywhere else
+	inline FloatN Select(const FloatN& mask, const FloatN& a, const FloatN& b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+	// one bit per lane, lane 0 is the lowest bit
+	inline int MoveMask(const FloatN& mask) { return _mm256_movemask_ps(mask.v); }
+
+	// expands one bit per lane back into a full lane mask
+	inline FloatN MaskFromBits(int bits)
+	{
+		const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+		return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), laneBits), laneBits));
+	}
+
+	// Width lanes of 64 bit integers, lanes 0-3 in low and 4-7 in high
+	struct Int64N
+	{
+		__m256i low;
+		__m256i high;
+
+		Int64N() = default;
+		Int64N(__m256i _low, __m256i _high) : low(_low), high(_high) {}
+		explicit Int64N(int64_t i) : low(_mm256_set1_epi64x(i)), high(low) {}
+
+		// base, base + step, base + 2 * step, ...
+		static Int64N Ramp(int64_t base, int64_t step)
+		{
+			return
+			{
+				_mm256_setr_epi64x(base, base + step, base + 2 * step, base + 3 * step),
+				_mm256_setr_epi64x(base + 4 * step, base + 5 * step, base + 6 * step, base + 7 * step)
+			};
+		}
+
+		Int64N operator|(const Int64N& o) const { return { _mm256_or_si256(low, o.low), _mm256_or_si256(high, o.high) }; }
+		Int64N& operator+=(const Int64N& o) { low = _mm256_add_epi64(low, o.low); high = _mm256_add_epi64(high, o.high); return *this; }
+	};
+
+	// one bit per negative lane, lane 0 is the lowest bit
+	inline int SignBits(const Int64N& i)
+	{
+		return _mm256_movemask_pd(_mm256_castsi256_pd(i.low)) | (_mm256_movemask_pd(_mm256_castsi256_pd(i.high)) << 4);
+	}
+#else
+	constexpr int Width{ 4 };
+
+	struct FloatN
+	{
+		__m128 v;
+
+		FloatN() = default;
+		FloatN(__m128 _v) : v(_v) {}
+		explicit FloatN(float f) : v(_mm_set1_ps(f)) {}
+
+		static FloatN Load(const float* p) { return _mm_loadu_ps(p); }
+		void Store(float* p) const { _mm_storeu_ps(p, v); }
+
+		// p[0], p[stride], p[2 * stride], ... there is no gather before AVX2, so the lanes are loaded one by one
+		static FloatN Gather(const float* p, int stride) { return _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]); }
+
+		// 0, 1, 2, ... Width - 1
+		static FloatN LaneOffsets() { return _mm_setr_ps(0.f, 1.f, 2.f, 3.f); }
+
+		FloatN operator+(const FloatN& o) const { return _mm_add_ps(v, o.v); }
+		FloatN operator-(const FloatN& o) const { return _mm_sub_ps(v, o.v); }
+		FloatN operator*(const FloatN& o) const { return _mm_mul_ps(v, o.v); }
+		FloatN operator/(const FloatN& o) const { return _mm_div_ps(v, o.v); }
+		FloatN& operator+=(const FloatN& o) { v = _mm_add_ps(v, o.v); return *this; }
+		FloatN Sqrt() const { return _mm_sqrt_ps(v); }
+
+		// comparisons return a mask with all bits set in the lanes where they hold
+		FloatN operator>(const FloatN& o) const { return _mm_cmpgt_ps(v, o.v); }
+		FloatN operator>=(const FloatN& o) const { return _mm_cmpge_ps(v, o.v); }
+		FloatN operator<(const FloatN& o) const { return _mm_cmplt_ps(v, o.v); }
+		FloatN operator<=(const FloatN& o) const { return _mm_cmple_ps(v, o.v); }
+		FloatN operator&(const FloatN& o) const { return _mm_and_ps(v, o.v); }
+		FloatN operator|(const FloatN& o) const { return _mm_or_ps(v, o.v); }
+	};
+
+	// picks a where the mask is set and b everywhere else, SSE2 has no blend so it is done with bit ops
+	inline FloatN Select(const FloatN& mask, const FloatN& a, const FloatN& b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+	// one bit per lane, lane 0 is the lowest bit
+	inline int MoveMask(const FloatN& mask) { return _mm_movemask_ps(mask.v); }
+
+	// expands one bit per lane back into a full lane mask
+	inline FloatN MaskFromBits(int bits)
+	{
+		const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+		return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(bits), laneBits), laneBits));
+	}
+
+	// Width lanes of 64 bit integers, lanes 0-1 in low and 2-3 in high
+	struct Int64N
+	{
+		__m128i low;
+		__m128i high;
+
+		Int64N() = default;
+		Int64N(__m128i _low, __m128i _high) : low(_low), high(_high) {}
+		explicit Int64N(int64_t i) : low(_mm_set1_epi64x(i)), high(low) {}
+
+		// base, base + step, base + 2 * step, ...
+		static Int64N Ramp(int64_t base, int64_t step)
+		{
+			return
+			{
+				_mm_set_epi64x(base + step, base),
+				_mm_set_epi64x(base + 3 * step, base + 2 * step)
+			};
+		}
+
+		Int64N operator|(const Int64N& o) const { return { _mm_or_si128(low, o.low), _mm_or_si128(high, o.high) }; }
+		Int64N& operator+=(const Int64N& o) { low = _mm_add_epi64(low, o.low); high = _mm_add_epi64(high, o.high); return *this; }
+	};
+
+	// one bit per negative lane, lane 0 is the lowest bit
+	inline int SignBits(const Int64N& i)
+	{
+		return _mm_movemask_pd(_mm_castsi128_pd(i.low)) | (_mm_movemask_pd(_mm_castsi128_pd(i.high)) << 2);
+	}
+#endif
+
+	constexpr int AllLanes{ (1 << Width) - 1 };
+
+	// one bit for every lane whose x = first + lane lies in [minX, maxX)
+	inline int LaneRangeBits(int first, int minX, int maxX)
+	{
+		const int begin = std::max(minX - first, 0);
+		const int end = std::min(maxX - first, Width);
+		if (begin >= end) return 0;
+
+		return ((1 << end) - 1) & ~((1 << begin) - 1);
+	}
+}
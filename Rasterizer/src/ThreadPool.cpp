@@ -0,0 +1,95 @@
+#include "ThreadPool.h"
+
+namespace dae
+{
+	ThreadPool::ThreadPool(unsigned int threadCount)
+	{
+		// hardware_concurrency is allowed to return 0, the calling thread counts as one
+		const unsigned int workerCount = threadCount > 1 ? threadCount - 1 : 0;
+
+		m_Workers.reserve(workerCount);
+		for (unsigned int i = 0; i < workerCount; ++i)
+		{
+			m_Workers.emplace_back(&ThreadPool::WorkerLoop, this);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_Quit = true;
+		}
+		m_WakeCondition.notify_all();
+
+		for (std::thread& worker : m_Workers)
+		{
+			worker.join();
+		}
+	}
+
+	void ThreadPool::ParallelFor(int count, const std::function<void(int)>& job)
+	{
+		if (count <= 0) return;
+
+		if (m_Workers.empty() || count == 1)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				job(i);
+			}
+			return;
+		}
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			m_pJob = &job;
+			m_JobCount = count;
+			m_NextIndex = 0;
+			m_BusyWorkers = static_cast<int>(m_Workers.size());
+			++m_Generation;
+		}
+		m_WakeCondition.notify_all();
+
+		RunJobs();
+
+		// every worker has to check in, otherwise one could still be reading m_pJob
+		std::unique_lock lock{ m_Mutex };
+		m_DoneCondition.wait(lock, [this] { return m_BusyWorkers == 0; });
+		m_pJob = nullptr;
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		uint64_t lastGeneration{};
+
+		while (true)
+		{
+			{
+				std::unique_lock lock{ m_Mutex };
+				m_WakeCondition.wait(lock, [this, lastGeneration] { return m_Quit || m_Generation != lastGeneration; });
+
+				if (m_Quit) return;
+				lastGeneration = m_Generation;
+			}
+
+			RunJobs();
+
+			{
+				std::lock_guard lock{ m_Mutex };
+				if (--m_BusyWorkers == 0)
+				{
+					m_DoneCondition.notify_one();
+				}
+			}
+		}
+	}
+
+	void ThreadPool::RunJobs()
+	{
+		for (int i = m_NextIndex++; i < m_JobCount; i = m_NextIndex++)
+		{
+			(*m_pJob)(i);
+		}
+	}
+}
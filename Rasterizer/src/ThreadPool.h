@@ -0,0 +1,47 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	// Fixed set of worker threads that split an index range between them.
+	// The calling thread always helps, so a pool of one thread runs everything inline.
+	class ThreadPool final
+	{
+	public:
+		explicit ThreadPool(unsigned int threadCount = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		// calls job(index) for every index in [0, count) and returns when all of them are done
+		void ParallelFor(int count, const std::function<void(int)>& job);
+
+		int GetThreadCount() const { return static_cast<int>(m_Workers.size()) + 1; }
+
+	private:
+		void WorkerLoop();
+		void RunJobs();
+
+		std::vector<std::thread> m_Workers;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WakeCondition;
+		std::condition_variable m_DoneCondition;
+
+		const std::function<void(int)>* m_pJob{ nullptr };
+		int m_JobCount{};
+		std::atomic<int> m_NextIndex{};
+		int m_BusyWorkers{};
+		uint64_t m_Generation{};
+		bool m_Quit{ false };
+	};
+}
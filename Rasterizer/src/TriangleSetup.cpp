@@ -0,0 +1,179 @@
+#include "TriangleSetup.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace dae
+{
+	bool TriangleSetup::Setup(const Triangle4& triangle, const float attributes[3][MaxAttributeCount], int attributeCount,
+		int width, int height, CullMode cullMode)
+	{
+		const Vertex_Out* vertices[3]{ &triangle.vertex0, &triangle.vertex1, &triangle.vertex2 };
+		const float* vertexAttributes[3]{ attributes[0], attributes[1], attributes[2] };
+
+		// 28.4 keeps the edge function products well inside 64 bits as long as
+		// coordinates stay below 2^24 pixels, anything further out can not be snapped
+		constexpr float maxCoordinate = 16777216.f;
+
+		int64_t fixedX[3];
+		int64_t fixedY[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vector4& position = vertices[i]->position;
+			if (!(std::abs(position.x) < maxCoordinate && std::abs(position.y) < maxCoordinate)) return false;
+
+			fixedX[i] = std::llround(position.x * SubPixelSteps);
+			fixedY[i] = std::llround(position.y * SubPixelSteps);
+		}
+
+		constexpr int64_t halfPixel = SubPixelSteps / 2;
+
+		// twice the signed area of the snapped triangle, positive when it is clockwise on screen
+		int64_t area = (fixedX[1] - fixedX[0]) * (fixedY[2] - fixedY[0]) - (fixedX[2] - fixedX[0]) * (fixedY[1] - fixedY[0]);
+
+		// degenerate triangles have no inside at all, culled ones are rejected before any plane is built
+		if (area == 0) return false;
+		if (cullMode == CullMode::Back && area < 0) return false;
+		if (cullMode == CullMode::Front && area > 0) return false;
+
+		// a counter clockwise triangle that is drawn anyway is turned around,
+		// so the edge functions stay positive on the inside
+		if (area < 0)
+		{
+			std::swap(vertices[1], vertices[2]);
+			std::swap(vertexAttributes[1], vertexAttributes[2]);
+			std::swap(fixedX[1], fixedX[2]);
+			std::swap(fixedY[1], fixedY[2]);
+			area = -area;
+		}
+
+		for (int i = 0; i < 3; ++i)
+		{
+			const int from = (i + 1) % 3;
+			const int to = (i + 2) % 3;
+
+			// E(P) = dy * (P.x - from.x) + dx * (P.y - from.y), its gradient points into the triangle
+			const int64_t dy = fixedY[from] - fixedY[to];
+			const int64_t dx = fixedX[to] - fixedX[from];
+
+			// top edges are horizontal with the inside below them, left edges have the inside on their right,
+			// every other edge drops the pixel centres lying exactly on it
+			const bool isTopLeft = dy > 0 || (dy == 0 && dx > 0);
+
+			edges[i].a = dy * SubPixelSteps;
+			edges[i].b = dx * SubPixelSteps;
+			edges[i].c = dy * (halfPixel - fixedX[from]) + dx * (halfPixel - fixedY[from]) - (isTopLeft ? 0 : 1);
+		}
+
+		const int64_t minFixedX = std::min(fixedX[0], std::min(fixedX[1], fixedX[2]));
+		const int64_t maxFixedX = std::max(fixedX[0], std::max(fixedX[1], fixedX[2]));
+		const int64_t minFixedY = std::min(fixedY[0], std::min(fixedY[1], fixedY[2]));
+		const int64_t maxFixedY = std::max(fixedY[0], std::max(fixedY[1], fixedY[2]));
+
+		// first and one past the last pixel whose centre lies inside the snapped bounds
+		minX = static_cast<int>(std::clamp<int64_t>((minFixedX - halfPixel + SubPixelSteps - 1) >> SubPixelBits, 0, width));
+		maxX = static_cast<int>(std::clamp<int64_t>(((maxFixedX - halfPixel) >> SubPixelBits) + 1, 0, width));
+		minY = static_cast<int>(std::clamp<int64_t>((minFixedY - halfPixel + SubPixelSteps - 1) >> SubPixelBits, 0, height));
+		maxY = static_cast<int>(std::clamp<int64_t>(((maxFixedY - halfPixel) >> SubPixelBits) + 1, 0, height));
+
+		if (minX >= maxX || minY >= maxY) return false;
+
+		// Slivers and tiny triangles often fit between pixel centres even though their bounds touch a few.
+		// Checking those few centres directly is cheaper than building the planes for nothing.
+		constexpr int maxProbedPixels = 4;
+		if ((maxX - minX) * (maxY - minY) <= maxProbedPixels && !CoversAnyPixel()) return false;
+
+		originX = static_cast<float>(fixedX[0]) / SubPixelSteps;
+		originY = static_cast<float>(fixedY[0]) / SubPixelSteps;
+
+		this->attributeCount = attributeCount;
+		const int varyingCount = static_cast<int>(Varying::FirstAttribute) + attributeCount;
+
+		float values[3][VaryingCount];
+		for (int i = 0; i < 3; ++i)
+		{
+			const float invW = 1.f / vertices[i]->position.w;
+
+			float* f = values[i];
+			f[static_cast<int>(Varying::Depth)] = vertices[i]->position.z;
+			f[static_cast<int>(Varying::InverseW)] = invW;
+			for (int k = 0; k < attributeCount; ++k)
+			{
+				f[static_cast<int>(Varying::FirstAttribute) + k] = vertexAttributes[i][k] * invW;
+			}
+		}
+
+		// barycentric weight i is edge i / area, so every attribute is a plane as well.
+		// At the first vertex the weights are 1, 0, 0, which gives the constant term directly.
+		const float invArea = 1.f / static_cast<float>(area);
+		for (int k = 0; k < varyingCount; ++k)
+		{
+			PlaneEquation& plane = varyings[k];
+			plane = {};
+			for (int i = 0; i < 3; ++i)
+			{
+				const float weight = values[i][k] * invArea;
+				plane.a += static_cast<float>(edges[i].a) * weight;
+				plane.b += static_cast<float>(edges[i].b) * weight;
+			}
+			plane.c = values[0][k];
+		}
+
+		// The depth plane is linear, so over the triangle it is smallest in one of the snapped corners.
+		// Evaluating it rounds, so keep a margin the size of a few ulps of the largest term.
+		const PlaneEquation& depth = varyings[static_cast<int>(Varying::Depth)];
+		float closest = std::numeric_limits<float>::max();
+		float largestTerm = std::abs(depth.c);
+		for (int i = 0; i < 3; ++i)
+		{
+			const float x = static_cast<float>(fixedX[i] - fixedX[0]) / SubPixelSteps;
+			const float y = static_cast<float>(fixedY[i] - fixedY[0]) / SubPixelSteps;
+			closest = std::min(closest, depth.Evaluate(x, y));
+			largestTerm = std::max(largestTerm, std::abs(depth.a * x) + std::abs(depth.b * y) + std::abs(depth.c));
+		}
+		minDepth = closest - 8 * std::numeric_limits<float>::epsilon() * largestTerm;
+
+		return true;
+	}
+
+	bool TriangleSetup::MayCover(const TileRect& rect) const
+	{
+		// an edge function is linear, so its largest value over the rect sits in one of the corners
+		for (const FixedEdge& edge : edges)
+		{
+			const int px = edge.a > 0 ? rect.maxX - 1 : rect.minX;
+			const int py = edge.b > 0 ? rect.maxY - 1 : rect.minY;
+			if (edge.Evaluate(px, py) < 0) return false;
+		}
+
+		return true;
+	}
+
+	bool TriangleSetup::CoversAnyPixel() const
+	{
+		for (int py = minY; py < maxY; ++py)
+		{
+			for (int px = minX; px < maxX; ++px)
+			{
+				if ((edges[0].Evaluate(px, py) | edges[1].Evaluate(px, py) | edges[2].Evaluate(px, py)) >= 0) return true;
+			}
+		}
+
+		return false;
+	}
+
+	float TriangleSetup::EvaluateAttributes(int px, int py, float attributes[MaxAttributeCount]) const
+	{
+		const float relativeX = PixelX(px);
+		const float relativeY = PixelY(py);
+
+		const float w = 1.f / varyings[static_cast<int>(Varying::InverseW)].Evaluate(relativeX, relativeY);
+		for (int k = 0; k < attributeCount; ++k)
+		{
+			attributes[k] = varyings[static_cast<int>(Varying::FirstAttribute) + k].Evaluate(relativeX, relativeY) * w;
+		}
+
+		return w;
+	}
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Planes interpolated across a triangle. The two fixed ones are followed by
+	// the attributes of the shader, as many floats as its varyings have.
+	// Depth is z / w, which is already linear in screen space, everything else is divided by w to become so.
+	enum class Varying
+	{
+		Depth,
+		InverseW,
+		FirstAttribute
+	};
+
+	// Which winding gets rejected before any pixel is looked at,
+	// front faces are the ones that show up clockwise on screen like in D3D
+	enum class CullMode
+	{
+		None,
+		Back,
+		Front
+	};
+
+	// Pixels a kernel is allowed to touch, max is exclusive
+	struct TileRect
+	{
+		int minX{};
+		int maxX{};
+		int minY{};
+		int maxY{};
+	};
+
+	// Edge function on vertices snapped to 28.4 fixed point, evaluated at pixel centres:
+	// E(px, py) = a * px + b * py + c for integer pixel coordinates.
+	// The top-left fill rule is folded into c, so a pixel is covered when E >= 0 for all three edges
+	// and a pixel centre on an edge shared by two triangles belongs to exactly one of them.
+	struct FixedEdge
+	{
+		int64_t a{};
+		int64_t b{};
+		int64_t c{};
+
+		int64_t Evaluate(int px, int py) const
+		{
+			return a * px + b * py + c;
+		}
+	};
+
+	// f(x, y) = a * x + b * y + c, with x and y relative to TriangleSetup::origin
+	struct PlaneEquation
+	{
+		float a{};
+		float b{};
+		float c{};
+
+		float Evaluate(float x, float y) const
+		{
+			return a * x + b * y + c;
+		}
+	};
+
+	// Everything the rasterizer needs from a triangle, computed once so the per-pixel loop only has to
+	// step the edges over the bounding box and evaluate the planes at the pixels they cover
+	struct TriangleSetup
+	{
+		// room for every attribute a Vertex_Out has besides its position
+		static constexpr int MaxAttributeCount{ 14 };
+		static constexpr int VaryingCount{ static_cast<int>(Varying::FirstAttribute) + MaxAttributeCount };
+		static constexpr int SubPixelBits{ 4 };
+		static constexpr int SubPixelSteps{ 1 << SubPixelBits };
+
+		// planes are evaluated relative to the first vertex, evaluating them around the screen origin
+		// throws away most of the float precision for small triangles far from it
+		float originX{};
+		float originY{};
+
+		// edge i is opposite vertex i
+		FixedEdge edges[3]{};
+		// only the fixed planes and the first attributeCount attribute planes are set up
+		PlaneEquation varyings[VaryingCount]{};
+		int attributeCount{};
+
+		// bounding box in pixels, max is exclusive
+		int minX{};
+		int maxX{};
+		int minY{};
+		int maxY{};
+
+		// closest depth any pixel of the triangle can get, used to reject it against coarse depth
+		float minDepth{};
+
+		// Returns false when the triangle can not cover any pixel of the target, when it is culled by its winding,
+		// or when a vertex lies too far outside the screen to be snapped to fixed point.
+		// attributes holds the first attributeCount shader attributes of every vertex, before the divide by w.
+		bool Setup(const Triangle4& triangle, const float attributes[3][MaxAttributeCount], int attributeCount,
+			int width, int height, CullMode cullMode = CullMode::Back);
+
+		// false when no pixel centre inside rect can be covered, rect has to be inside the bounding box
+		bool MayCover(const TileRect& rect) const;
+
+		// tests every pixel centre of the bounding box, only meant for tiny triangles
+		bool CoversAnyPixel() const;
+
+		// Pixel centre relative to the origin, the x and y every plane is evaluated at.
+		// The kernels and EvaluateAttributes all go through these so they round the same way.
+		float PixelX(int px) const
+		{
+			return static_cast<float>(px) + (0.5f - originX);
+		}
+
+		float PixelY(int py) const
+		{
+			return static_cast<float>(py) + 0.5f - originY;
+		}
+
+		// perspective correct attributes at the centre of a pixel, returns w there
+		float EvaluateAttributes(int px, int py, float attributes[MaxAttributeCount]) const;
+
+		// Screen space derivatives of the first count attributes, from their perspective correct values and w at a pixel.
+		// u = (u/w) / (1/w), so du/dx = (d(u/w)/dx - u * d(1/w)/dx) * w, and the same along y.
+		// pDerivatives gets the count ddx values followed by the count ddy values.
+		void Differentiate(const float* attributes, float w, int count, float* pDerivatives) const
+		{
+			const PlaneEquation& wPlane = varyings[static_cast<int>(Varying::InverseW)];
+			for (int k = 0; k < count; ++k)
+			{
+				const PlaneEquation& plane = varyings[static_cast<int>(Varying::FirstAttribute) + k];
+				pDerivatives[k] = (plane.a - attributes[k] * wPlane.a) * w;
+				pDerivatives[count + k] = (plane.b - attributes[k] * wPlane.b) * w;
+			}
+		}
+	};
+}
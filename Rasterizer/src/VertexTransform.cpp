@@ -0,0 +1,140 @@
+#include "VertexTransform.h"
+#include <algorithm>
+#include "Simd.h"
+
+namespace dae
+{
+	namespace
+	{
+		using simd::FloatN;
+		constexpr int lanes = simd::Width;
+
+		static_assert(sizeof(Vertex) % sizeof(float) == 0, "vertex components are gathered as floats");
+		constexpr int vertexStride = sizeof(Vertex) / sizeof(float);
+
+		// every matrix element broadcast to all lanes
+		struct MatrixN
+		{
+			FloatN m[4][4];
+
+			explicit MatrixN(const Matrix& matrix)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					const Vector4 values = matrix[row];
+					for (int column = 0; column < 4; ++column)
+					{
+						m[row][column] = FloatN{ values[column] };
+					}
+				}
+			}
+		};
+
+		struct Vector3N
+		{
+			FloatN x;
+			FloatN y;
+			FloatN z;
+		};
+
+		Vector3N Gather(const float* pComponent)
+		{
+			return
+			{
+				FloatN::Gather(pComponent, vertexStride),
+				FloatN::Gather(pComponent + 1, vertexStride),
+				FloatN::Gather(pComponent + 2, vertexStride)
+			};
+		}
+
+		// same as Matrix::TransformVector, for all lanes at once
+		Vector3N TransformVector(const MatrixN& matrix, const Vector3N& v)
+		{
+			return
+			{
+				matrix.m[0][0] * v.x + matrix.m[1][0] * v.y + matrix.m[2][0] * v.z,
+				matrix.m[0][1] * v.x + matrix.m[1][1] * v.y + matrix.m[2][1] * v.z,
+				matrix.m[0][2] * v.x + matrix.m[1][2] * v.y + matrix.m[2][2] * v.z
+			};
+		}
+
+		// transforms one full group of simd::Width vertices
+		void TransformGroup(const VertexTransform& transform, const MatrixN& worldViewProjection, const MatrixN& world,
+			const Vertex* pVertices, Vertex_Out* pOut, int count)
+		{
+			const FloatN one{ 1.f };
+			const FloatN half{ 0.5f };
+
+			const Vector3N position = Gather(&pVertices->position.x);
+			const Vector3N normal = TransformVector(world, Gather(&pVertices->normal.x));
+			const Vector3N tangent = TransformVector(world, Gather(&pVertices->tangent.x));
+
+			// w of the model position is 1, so the last row is added as it is
+			const MatrixN& m = worldViewProjection;
+			const FloatN clipX = m.m[0][0] * position.x + m.m[1][0] * position.y + m.m[2][0] * position.z + m.m[3][0];
+			const FloatN clipY = m.m[0][1] * position.x + m.m[1][1] * position.y + m.m[2][1] * position.z + m.m[3][1];
+			const FloatN clipZ = m.m[0][2] * position.x + m.m[1][2] * position.y + m.m[2][2] * position.z + m.m[3][2];
+			const FloatN clipW = m.m[0][3] * position.x + m.m[1][3] * position.y + m.m[2][3] * position.z + m.m[3][3];
+
+			// the view direction is taken from the projected position, like Renderer::ProjectToScreen does it
+			const FloatN invW = one / clipW;
+			const FloatN screenX = (clipX * invW + one) * half * FloatN{ transform.screenWidth };
+			const FloatN screenY = (one - clipY * invW) * half * FloatN{ transform.screenHeight };
+			const FloatN ndcZ = clipZ * invW;
+
+			const FloatN viewX = FloatN{ transform.cameraOrigin.x } - screenX;
+			const FloatN viewY = FloatN{ transform.cameraOrigin.y } - screenY;
+			const FloatN viewZ = FloatN{ transform.cameraOrigin.z } - ndcZ;
+			const FloatN invLength = one / (viewX * viewX + viewY * viewY + viewZ * viewZ).Sqrt();
+
+			alignas(32) float values[13][lanes];
+			clipX.Store(values[0]);
+			clipY.Store(values[1]);
+			clipZ.Store(values[2]);
+			clipW.Store(values[3]);
+			normal.x.Store(values[4]);
+			normal.y.Store(values[5]);
+			normal.z.Store(values[6]);
+			tangent.x.Store(values[7]);
+			tangent.y.Store(values[8]);
+			tangent.z.Store(values[9]);
+			(viewX * invLength).Store(values[10]);
+			(viewY * invLength).Store(values[11]);
+			(viewZ * invLength).Store(values[12]);
+
+			for (int lane = 0; lane < count; ++lane)
+			{
+				const Vertex& vertex = pVertices[lane];
+				pOut[lane] =
+				{
+					Vector4{ values[0][lane], values[1][lane], values[2][lane], values[3][lane] },
+					vertex.color,
+					vertex.uv,
+					Vector3{ values[4][lane], values[5][lane], values[6][lane] },
+					Vector3{ values[7][lane], values[8][lane], values[9][lane] },
+					Vector3{ values[10][lane], values[11][lane], values[12][lane] }
+				};
+			}
+		}
+	}
+
+	void TransformVertices(const VertexTransform& transform, const Vertex* pVertices, Vertex_Out* pOut, int count)
+	{
+		const MatrixN worldViewProjection{ transform.worldViewProjection };
+		const MatrixN world{ transform.world };
+
+		int first = 0;
+		for (; first + lanes <= count; first += lanes)
+		{
+			TransformGroup(transform, worldViewProjection, world, pVertices + first, pOut + first, lanes);
+		}
+
+		// the last partial group is copied out first, so the gathers never read past the end
+		if (first < count)
+		{
+			Vertex tail[lanes]{};
+			std::copy(pVertices + first, pVertices + count, tail);
+			TransformGroup(transform, worldViewProjection, world, tail, pOut + first, count - first);
+		}
+	}
+}
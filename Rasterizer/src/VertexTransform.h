@@ -0,0 +1,20 @@
+#pragma once
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Everything the vertex stage needs for one draw, the world view projection product is built once per draw
+	struct VertexTransform
+	{
+		Matrix worldViewProjection{};
+		Matrix world{};
+		Vector3 cameraOrigin{};
+		float screenWidth{};
+		float screenHeight{};
+	};
+
+	// Moves positions to clip space and normals and tangents to world space.
+	// simd::Width vertices go through at a time, every component is gathered into its own register
+	// so the matrix products run as plain multiply adds over whole registers.
+	void TransformVertices(const VertexTransform& transform, const Vertex* pVertices, Vertex_Out* pOut, int count);
+}
@@ -76,8 +76,14 @@ int main(int argc, char* args[])
 					pRenderer->RotateModel();
 				if (e.key.keysym.scancode == SDL_SCANCODE_N)
 					pRenderer->ToggleNormalMap();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
+					pRenderer->CycleCullMode();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
 					pRenderer->CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+					pRenderer->ToggleRasterPath();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+					pRenderer->ToggleDeferredShading();
 
 
 				break;
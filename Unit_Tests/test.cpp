@@ -1,5 +1,16 @@
 #include "gtest/gtest.h"
 #include "Maths.h"
+#include "BoundingVolumeHierarchy.h"
+#include "Frustum.h"
+#include "MeshSimplifier.h"
+#include "RasterKernels.h"
+#include "TriangleSetup.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
 
 
 namespace dae
@@ -9,4 +20,415 @@ namespace dae
 		EXPECT_TRUE(true);
 	}
 
+	namespace
+	{
+		constexpr int TargetSize{ 64 };
+
+		// how often every pixel got shaded and the depth it ended up with, by one of the raster kernels
+		struct Coverage
+		{
+			std::vector<int> counts = std::vector<int>(TargetSize * TargetSize, 0);
+			std::vector<float> depths = std::vector<float>(TargetSize * TargetSize, 1.f);
+		};
+
+		// screen space corner, the depth slopes a little so the planes are not all constant
+		Vertex_Out ScreenVertex(float x, float y)
+		{
+			Vertex_Out vertex{};
+			vertex.position = Vector4{ x, y, 0.25f + 0.002f * x + 0.001f * y, 1.f };
+			return vertex;
+		}
+
+		template<bool UseSimd>
+		Coverage Rasterize(const std::vector<Triangle4>& triangles)
+		{
+			Coverage coverage{};
+			const TileRect target{ 0, TargetSize, 0, TargetSize };
+			const float attributes[3][TriangleSetup::MaxAttributeCount]{};
+
+			for (const Triangle4& triangle : triangles)
+			{
+				TriangleSetup setup{};
+				if (!setup.Setup(triangle, attributes, 0, TargetSize, TargetSize, CullMode::None)) continue;
+
+				// every triangle gets a fresh depth test, only the coverage itself is compared
+				std::vector<float> depthBuffer(TargetSize * TargetSize, 1.f);
+				const auto countPixel = [&](int px, int py, float depth, const float*, const float*)
+					{
+						++coverage.counts[px + py * TargetSize];
+						coverage.depths[px + py * TargetSize] = depth;
+					};
+
+				if constexpr (UseSimd)
+				{
+					RasterizeSimd<0, 0>(setup, target, depthBuffer.data(), TargetSize, countPixel);
+				}
+				else
+				{
+					RasterizeScalar<0, 0>(setup, target, depthBuffer.data(), TargetSize, countPixel);
+				}
+			}
+			return coverage;
+		}
+
+		// Two triangles per cell of a grid over [min, max] in whole pixels, so no pixel centre lies on the outer border.
+		// Inner corners are moved by jitter, in sixteenths of a pixel, so edges cross pixel centres at all kinds of slopes.
+		std::vector<Triangle4> TriangulateGrid(float min, float max, int cells, int jitter)
+		{
+			const int points = cells + 1;
+			std::vector<Vertex_Out> corners;
+			for (int row = 0; row < points; ++row)
+			{
+				for (int column = 0; column < points; ++column)
+				{
+					float x = min + (max - min) * column / cells;
+					float y = min + (max - min) * row / cells;
+
+					const bool inner = row > 0 && row < cells && column > 0 && column < cells;
+					if (inner)
+					{
+						// inner corners sit on pixel centres, then get pushed around deterministically
+						x = std::floor(x) + 0.5f + static_cast<float>((row * 7 + column * 3) % (2 * jitter + 1) - jitter) / 16.f;
+						y = std::floor(y) + 0.5f + static_cast<float>((row * 5 + column * 11) % (2 * jitter + 1) - jitter) / 16.f;
+					}
+					corners.push_back(ScreenVertex(x, y));
+				}
+			}
+
+			std::vector<Triangle4> triangles;
+			for (int row = 0; row < cells; ++row)
+			{
+				for (int column = 0; column < cells; ++column)
+				{
+					const Vertex_Out& topLeft = corners[row * points + column];
+					const Vertex_Out& topRight = corners[row * points + column + 1];
+					const Vertex_Out& bottomLeft = corners[(row + 1) * points + column];
+					const Vertex_Out& bottomRight = corners[(row + 1) * points + column + 1];
+
+					// both diagonals, and both windings
+					if ((row + column) % 2 == 0)
+					{
+						triangles.push_back({ topLeft, topRight, bottomRight });
+						triangles.push_back({ topLeft, bottomLeft, bottomRight });
+					}
+					else
+					{
+						triangles.push_back({ topLeft, topRight, bottomLeft });
+						triangles.push_back({ topRight, bottomRight, bottomLeft });
+					}
+				}
+			}
+			return triangles;
+		}
+
+		// Triangles from centre to every pair of neighbouring points on the border of the square [min, max],
+		// the border runs along whole pixel lines so only the edges through the centre can hit pixel centres.
+		std::vector<Triangle4> TriangulateFan(float min, float max, float centreX, float centreY, int pointsPerSide)
+		{
+			std::vector<Vertex_Out> border;
+			const float step = (max - min) / pointsPerSide;
+			for (int i = 0; i < pointsPerSide; ++i) border.push_back(ScreenVertex(min + step * i, min));
+			for (int i = 0; i < pointsPerSide; ++i) border.push_back(ScreenVertex(max, min + step * i));
+			for (int i = 0; i < pointsPerSide; ++i) border.push_back(ScreenVertex(max - step * i, max));
+			for (int i = 0; i < pointsPerSide; ++i) border.push_back(ScreenVertex(min, max - step * i));
+
+			const Vertex_Out centre = ScreenVertex(centreX, centreY);
+			std::vector<Triangle4> triangles;
+			for (size_t i = 0; i < border.size(); ++i)
+			{
+				triangles.push_back({ centre, border[i], border[(i + 1) % border.size()] });
+			}
+			return triangles;
+		}
+
+		// every pixel whose centre lies inside [min, max] exactly once, the others never
+		void ExpectCoveredOnce(const Coverage& coverage, int min, int max)
+		{
+			for (int py = 0; py < TargetSize; ++py)
+			{
+				for (int px = 0; px < TargetSize; ++px)
+				{
+					const bool inside = px >= min && px < max && py >= min && py < max;
+					EXPECT_EQ(coverage.counts[px + py * TargetSize], inside ? 1 : 0) << "pixel " << px << ", " << py;
+				}
+			}
+		}
+
+		void ExpectSameCoverage(const Coverage& scalar, const Coverage& simd)
+		{
+			EXPECT_EQ(scalar.counts, simd.counts);
+			EXPECT_EQ(scalar.depths, simd.depths);
+		}
+	}
+
+	TEST(FillRule, SharedEdgesOnPixelCentresCoverOnce)
+	{
+		const std::vector<Triangle4> triangles = TriangulateGrid(4.f, 60.f, 8, 0);
+
+		const Coverage scalar = Rasterize<false>(triangles);
+		ExpectCoveredOnce(scalar, 4, 60);
+		ExpectSameCoverage(scalar, Rasterize<true>(triangles));
+	}
+
+	TEST(FillRule, SharedEdgesAtAnySlopeCoverOnce)
+	{
+		const std::vector<Triangle4> triangles = TriangulateGrid(4.f, 60.f, 8, 7);
+
+		const Coverage scalar = Rasterize<false>(triangles);
+		ExpectCoveredOnce(scalar, 4, 60);
+		ExpectSameCoverage(scalar, Rasterize<true>(triangles));
+	}
+
+	TEST(FillRule, FanAroundPixelCentreCoversOnce)
+	{
+		const std::vector<Triangle4> triangles = TriangulateFan(8.f, 56.f, 32.5f, 32.5f, 6);
+
+		const Coverage scalar = Rasterize<false>(triangles);
+		ExpectCoveredOnce(scalar, 8, 56);
+		ExpectSameCoverage(scalar, Rasterize<true>(triangles));
+	}
+
+	TEST(FillRule, FanAroundSubPixelVertexCoversOnce)
+	{
+		const std::vector<Triangle4> triangles = TriangulateFan(8.f, 56.f, 20.3125f, 41.75f, 5);
+
+		const Coverage scalar = Rasterize<false>(triangles);
+		ExpectCoveredOnce(scalar, 8, 56);
+		ExpectSameCoverage(scalar, Rasterize<true>(triangles));
+	}
+
+	namespace
+	{
+		// same numbers on every platform, unlike the standard distributions
+		class Random
+		{
+		public:
+			explicit Random(uint32_t seed) : m_State(seed) {}
+
+			// uniform in [min, max)
+			float Next(float min, float max)
+			{
+				m_State = m_State * 1664525u + 1013904223u;
+				return min + (max - min) * static_cast<float>(m_State >> 8) / 16777216.f;
+			}
+
+		private:
+			uint32_t m_State;
+		};
+
+		// scaled, turned and moved unit boxes spread around the origin
+		std::vector<Matrix> RandomWorldMatrices(Random& random, size_t count)
+		{
+			std::vector<Matrix> worlds;
+			for (size_t i = 0; i < count; ++i)
+			{
+				const float scale = random.Next(0.5f, 8.f);
+				const Matrix rotation = Matrix::CreateRotation(random.Next(0.f, 6.28f), random.Next(0.f, 6.28f), random.Next(0.f, 6.28f));
+				const Vector3 position{ random.Next(-300.f, 300.f), random.Next(-60.f, 60.f), random.Next(-300.f, 300.f) };
+				worlds.push_back(Matrix::CreateScale(scale, scale, scale) * rotation * Matrix::CreateTranslation(position));
+			}
+			return worlds;
+		}
+
+		std::vector<BoundingBox> WorldBoxes(const std::vector<Matrix>& worlds)
+		{
+			const BoundingBox unitBox{ Vector3{ -1.f, -1.f, -1.f }, Vector3{ 1.f, 1.f, 1.f } };
+
+			std::vector<BoundingBox> boxes;
+			for (const Matrix& world : worlds)
+			{
+				boxes.push_back(unitBox.Transformed(world));
+			}
+			return boxes;
+		}
+
+		// a camera at origin turned by yaw, with the projection the renderer uses
+		Frustum MakeFrustum(const Vector3& origin, float yaw)
+		{
+			const Matrix view = Matrix::CreateLookAtLH(origin, Vector3{ std::sin(yaw), 0.f, std::cos(yaw) }, Vector3::UnitY);
+			const Matrix projection = Matrix::CreatePerspectiveFovLH(std::tan(45.f * TO_RADIANS), 4.f / 3.f, 0.1f, 400.f);
+			return Frustum::FromViewProjection(view * projection);
+		}
+
+		// Every box touching the frustum in the query result and nothing else, closest centre first.
+		void ExpectSameAsBruteForce(const BoundingVolumeHierarchy& hierarchy, const std::vector<BoundingBox>& boxes, const Frustum& frustum, const Vector3& origin)
+		{
+			std::vector<uint32_t> result;
+			hierarchy.Query(frustum, origin, result);
+
+			const auto distance = [&](uint32_t item)
+				{
+					return ((boxes[item].min + boxes[item].max) * 0.5f - origin).SqrMagnitude();
+				};
+			for (size_t i = 1; i < result.size(); ++i)
+			{
+				EXPECT_LE(distance(result[i - 1]), distance(result[i])) << "result " << i << " is out of order";
+			}
+
+			std::vector<uint32_t> expected;
+			for (uint32_t item = 0; item < boxes.size(); ++item)
+			{
+				if (frustum.Intersects(boxes[item])) expected.push_back(item);
+			}
+
+			std::sort(result.begin(), result.end());
+			EXPECT_EQ(result, expected);
+		}
+	}
+
+	TEST(BoundingVolumeHierarchy, QueryMatchesBruteForceAfterBuild)
+	{
+		Random random{ 7 };
+		const std::vector<BoundingBox> boxes = WorldBoxes(RandomWorldMatrices(random, 500));
+
+		BoundingVolumeHierarchy hierarchy;
+		hierarchy.Build(boxes);
+		ASSERT_EQ(hierarchy.GetItemCount(), boxes.size());
+
+		for (int view = 0; view < 8; ++view)
+		{
+			const Vector3 origin{ random.Next(-100.f, 100.f), random.Next(-20.f, 20.f), random.Next(-100.f, 100.f) };
+			ExpectSameAsBruteForce(hierarchy, boxes, MakeFrustum(origin, view * 0.8f), origin);
+		}
+	}
+
+	TEST(BoundingVolumeHierarchy, QueryMatchesBruteForceAfterRefit)
+	{
+		Random random{ 11 };
+		std::vector<Matrix> worlds = RandomWorldMatrices(random, 500);
+
+		BoundingVolumeHierarchy hierarchy;
+		hierarchy.Build(WorldBoxes(worlds));
+
+		// small moves keep the tree tight, the later large ones make Refit ask for a rebuild, it has to stay correct either way
+		for (int frame = 0; frame < 6; ++frame)
+		{
+			const float reach = frame < 3 ? 5.f : 150.f;
+			for (Matrix& world : worlds)
+			{
+				world = world * Matrix::CreateRotationY(random.Next(-0.5f, 0.5f))
+					* Matrix::CreateTranslation(random.Next(-reach, reach), random.Next(-reach, reach) * 0.2f, random.Next(-reach, reach));
+			}
+
+			const std::vector<BoundingBox> boxes = WorldBoxes(worlds);
+			hierarchy.Refit(boxes);
+
+			for (int view = 0; view < 4; ++view)
+			{
+				const Vector3 origin{ random.Next(-100.f, 100.f), random.Next(-20.f, 20.f), random.Next(-100.f, 100.f) };
+				ExpectSameAsBruteForce(hierarchy, boxes, MakeFrustum(origin, view * 1.6f), origin);
+			}
+		}
+	}
+
+	namespace
+	{
+		// A cube with every face split into cells x cells quads, pushed out onto an ellipsoid with the given radii.
+		// Corners shared by several faces are one vertex, so the mesh is closed and has no seams to lock.
+		Mesh MakeEllipsoid(int cells, const Vector3& radii)
+		{
+			Mesh mesh{};
+			mesh.primitiveTopology = PrimitiveTopology::TriangleList;
+
+			// lattice points on the cube surface, keyed by their integer coordinates
+			std::map<std::tuple<int, int, int>, uint32_t> lattice;
+			const auto vertexAt = [&](int x, int y, int z)
+				{
+					const auto [it, inserted] = lattice.emplace(std::make_tuple(x, y, z), static_cast<uint32_t>(mesh.vertices.size()));
+					if (inserted)
+					{
+						Vector3 direction{ x - cells * 0.5f, y - cells * 0.5f, z - cells * 0.5f };
+						direction.Normalize();
+
+						Vertex vertex{};
+						vertex.position = { direction.x * radii.x, direction.y * radii.y, direction.z * radii.z };
+						mesh.vertices.push_back(vertex);
+					}
+					return it->second;
+				};
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				for (int side = 0; side <= cells; side += cells)
+				{
+					for (int u = 0; u < cells; ++u)
+					{
+						for (int v = 0; v < cells; ++v)
+						{
+							// the face point (u, v) on this side of the cube, with axis as the fixed coordinate
+							const auto corner = [&](int du, int dv)
+								{
+									int coordinates[3]{};
+									coordinates[axis] = side;
+									coordinates[(axis + 1) % 3] = u + du;
+									coordinates[(axis + 2) % 3] = v + dv;
+									return vertexAt(coordinates[0], coordinates[1], coordinates[2]);
+								};
+
+							uint32_t quad[4]{ corner(0, 0), corner(1, 0), corner(1, 1), corner(0, 1) };
+							// every face turned to look outwards
+							const Vector3 normal = Vector3::Cross(mesh.vertices[quad[1]].position - mesh.vertices[quad[0]].position,
+								mesh.vertices[quad[2]].position - mesh.vertices[quad[0]].position);
+							if (Vector3::Dot(normal, mesh.vertices[quad[0]].position) < 0.f) std::swap(quad[1], quad[3]);
+
+							mesh.indices.insert(mesh.indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+						}
+					}
+				}
+			}
+
+			mesh.ComputeBounds();
+			return mesh;
+		}
+
+		// every edge used by exactly two triangles, once in each direction, and no triangle twice
+		void ExpectClosedManifold(const Mesh& mesh)
+		{
+			std::map<std::pair<uint32_t, uint32_t>, int> edgeUses;
+			std::map<std::tuple<uint32_t, uint32_t, uint32_t>, int> triangleUses;
+			for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+			{
+				uint32_t corners[3]{ mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2] };
+				ASSERT_TRUE(corners[0] != corners[1] && corners[1] != corners[2] && corners[2] != corners[0]) << "triangle " << i / 3 << " is degenerate";
+
+				for (int corner = 0; corner < 3; ++corner)
+				{
+					++edgeUses[{ corners[corner], corners[(corner + 1) % 3] }];
+				}
+
+				std::sort(std::begin(corners), std::end(corners));
+				++triangleUses[{ corners[0], corners[1], corners[2] }];
+			}
+
+			for (const auto& [edge, uses] : edgeUses)
+			{
+				EXPECT_EQ(uses, 1) << "edge " << edge.first << " -> " << edge.second;
+				const auto opposite = edgeUses.find({ edge.second, edge.first });
+				EXPECT_TRUE(opposite != edgeUses.end() && opposite->second == 1) << "edge " << edge.first << " -> " << edge.second << " has no single opposite";
+			}
+			for (const auto& [triangle, uses] : triangleUses)
+			{
+				EXPECT_EQ(uses, 1) << "triangle " << std::get<0>(triangle) << ", " << std::get<1>(triangle) << ", " << std::get<2>(triangle);
+			}
+		}
+	}
+
+	TEST(MeshSimplifier, LodsOfClosedMeshStayClosed)
+	{
+		// Round and flat ones, finely and coarsely split. The last levels take the coarse ones down to a handful of
+		// triangles, that is where collapses pinch the surface, on the thin rim of the flat ones first.
+		const Mesh meshes[]{ MakeEllipsoid(12, { 1.f, 1.f, 1.f }), MakeEllipsoid(12, { 4.f, 0.2f, 2.f }), MakeEllipsoid(6, { 1.f, 1.f, 1.f }), MakeEllipsoid(4, { 3.f, 0.3f, 1.f }) };
+		for (const Mesh& mesh : meshes)
+		{
+			ExpectClosedManifold(mesh);
+
+			const std::vector<Mesh> lods = MeshSimplifier::BuildLods(mesh, { 0.005f, 0.02f, 0.08f, 0.3f, 1.f });
+			ASSERT_FALSE(lods.empty());
+			for (const Mesh& lod : lods)
+			{
+				EXPECT_LT(lod.indices.size(), mesh.indices.size());
+				ExpectClosedManifold(lod);
+			}
+		}
+	}
 }